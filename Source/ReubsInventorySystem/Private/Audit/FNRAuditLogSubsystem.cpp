@@ -0,0 +1,122 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Audit/FNRAuditLogSubsystem.h"
+
+#include "Async/Async.h"
+#include "Core/FNRInventoryComponent.h"
+#include "Core/FNRInventoryItem.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "TimerManager.h"
+
+namespace
+{
+	const TCHAR* LexAuditAction(const EInventoryAuditAction Action)
+	{
+		switch (Action)
+		{
+		case EInventoryAuditAction::IAA_Add: return TEXT("Add");
+		case EInventoryAuditAction::IAA_Consume: return TEXT("Consume");
+		case EInventoryAuditAction::IAA_Drop: return TEXT("Drop");
+		case EInventoryAuditAction::IAA_Remove: return TEXT("Remove");
+		case EInventoryAuditAction::IAA_Import: return TEXT("Import");
+		case EInventoryAuditAction::IAA_Clear: return TEXT("Clear");
+		case EInventoryAuditAction::IAA_Transfer: return TEXT("Transfer");
+		case EInventoryAuditAction::IAA_Rejected: return TEXT("Rejected");
+		default: return TEXT("Unknown");
+		}
+	}
+}
+
+void UFNRAuditLogSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Buffer.Reserve(BufferCapacity);
+	LogPath = FPaths::ProjectSavedDir() / TEXT("Audit") / FString::Printf(TEXT("Inventory_%s.csv"), *FDateTime::UtcNow().ToString());
+}
+
+void UFNRAuditLogSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!bEnabled || InWorld.GetNetMode() == NM_Client)
+		return;
+
+	InWorld.GetTimerManager().SetTimer(FlushTimerHandle, FTimerDelegate::CreateUObject(this, &ThisClass::Flush), FlushInterval, true);
+}
+
+void UFNRAuditLogSubsystem::Deinitialize()
+{
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+
+	Flush();
+
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+
+	Super::Deinitialize();
+}
+
+void UFNRAuditLogSubsystem::Record(const UFNRInventoryComponent* Inventory, const EInventoryAuditAction Action, const UFNRInventoryItem* Item, const int32 Quantity)
+{
+	if (!bEnabled || BufferCapacity <= 0)
+		return;
+
+	if (Buffer.Num() >= BufferCapacity)
+	{
+		Flush();
+	}
+
+	FAuditEntry* Entry;
+	if (Buffer.Num() < BufferCapacity)
+	{
+		Entry = &Buffer.AddDefaulted_GetRef();
+	}
+	else
+	{
+		// Still writing the previous batch, overwrite the oldest entry rather than stall the game thread
+		Entry = &Buffer[Head];
+		Head = (Head + 1) % BufferCapacity;
+		++OverwrittenEntries;
+	}
+
+	Entry->Time = FDateTime::UtcNow();
+	Entry->ItemId = IsValid(Item) ? Item->ItemId : 0;
+	Entry->Inventory = IsValid(Inventory) ? Inventory->GetAuditId() : NAME_None;
+	Entry->ItemClass = IsValid(Item) ? Item->GetClass()->GetFName() : NAME_None;
+	Entry->Quantity = Quantity;
+	Entry->Action = Action;
+}
+
+void UFNRAuditLogSubsystem::Flush()
+{
+	if (Buffer.IsEmpty() || (PendingWrite.IsValid() && !PendingWrite.IsReady()))
+		return;
+
+	TArray<FAuditEntry> Entries = MoveTemp(Buffer);
+	Buffer.Reset(BufferCapacity);
+
+	const int32 Start = Head;
+	Head = 0;
+
+	PendingWrite = Async(EAsyncExecution::ThreadPool, [Entries = MoveTemp(Entries), Start, Path = LogPath]()
+	{
+		FString Text;
+		Text.Reserve(Entries.Num() * 96);
+
+		for (int32 Offset = 0; Offset < Entries.Num(); ++Offset)
+		{
+			const FAuditEntry& Entry = Entries[(Start + Offset) % Entries.Num()];
+			Text += FString::Printf(TEXT("%s,%s,%s,%lld,%s,%d\n"), *Entry.Time.ToIso8601(), LexAuditAction(Entry.Action), *Entry.Inventory.ToString(), Entry.ItemId, *Entry.ItemClass.ToString(), Entry.Quantity);
+		}
+
+		FFileHelper::SaveStringToFile(Text, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+	});
+}
@@ -0,0 +1,244 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Core/FNREquipmentComponent.h"
+
+#include "Core/FNRInventoryComponent.h"
+#include "Core/FNRInventoryItem.h"
+#include "Net/UnrealNetwork.h"
+
+UFNREquipmentComponent::UFNREquipmentComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+/*
+ * Replication
+ */
+
+void UFNREquipmentComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(UFNREquipmentComponent, EquippedItems, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(UFNREquipmentComponent, EquippedSummary, COND_SkipOwner);
+}
+
+void UFNREquipmentComponent::OnRep_EquippedItems()
+{
+	bStatsDirty = true;
+	OnEquipmentUpdated.Broadcast();
+}
+
+void UFNREquipmentComponent::OnRep_EquippedSummary()
+{
+	OnEquipmentUpdated.Broadcast();
+}
+
+/*
+ * Behaviour
+ */
+
+void UFNREquipmentComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Inventory = GetOwner()->FindComponentByClass<UFNRInventoryComponent>();
+
+	if (IsValid(Inventory) && GetOwnerRole() >= ROLE_Authority)
+	{
+		ItemChangedHandle = Inventory->OnItemChanged.AddUObject(this, &ThisClass::OnInventoryItemChanged);
+	}
+}
+
+void UFNREquipmentComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (IsValid(Inventory))
+	{
+		Inventory->OnItemChanged.Remove(ItemChangedHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool UFNREquipmentComponent::EquipItem(UFNRInventoryItem* Item)
+{
+	if (GetOwnerRole() < ROLE_Authority)
+	{
+		ServerEquipItem(IsValid(Item) ? Item->ItemId : 0);
+		return false;
+	}
+
+	if (!IsValid(Item) || !IsValid(Inventory) || Item->GetOwningInventory() != Inventory)
+		return false;
+
+	if (Item->EquipmentSlot.IsNone() || !Slots.Contains(Item->EquipmentSlot))
+		return false;
+
+	FEquippedItem* Existing = EquippedItems.FindByPredicate([Item](const FEquippedItem& Equipped)
+	{
+		return Equipped.Slot == Item->EquipmentSlot;
+	});
+
+	if (Existing)
+	{
+		if (Existing->Item == Item)
+			return true;
+
+		Existing->Item = Item;
+	}
+	else
+	{
+		FEquippedItem& Equipped = EquippedItems.AddDefaulted_GetRef();
+		Equipped.Slot = Item->EquipmentSlot;
+		Equipped.Item = Item;
+	}
+
+	OnEquipmentChanged();
+	return true;
+}
+
+void UFNREquipmentComponent::ServerEquipItem_Implementation(const int64 ItemId)
+{
+	if (IsValid(Inventory))
+	{
+		EquipItem(Inventory->FindItemById(ItemId));
+	}
+}
+
+bool UFNREquipmentComponent::UnequipSlot(const FName Slot)
+{
+	if (GetOwnerRole() < ROLE_Authority)
+	{
+		ServerUnequipSlot(Slot);
+		return false;
+	}
+
+	const int32 Removed = EquippedItems.RemoveAll([Slot](const FEquippedItem& Equipped)
+	{
+		return Equipped.Slot == Slot;
+	});
+
+	if (Removed <= 0)
+		return false;
+
+	OnEquipmentChanged();
+	return true;
+}
+
+void UFNREquipmentComponent::ServerUnequipSlot_Implementation(const FName Slot)
+{
+	UnequipSlot(Slot);
+}
+
+void UFNREquipmentComponent::OnInventoryItemChanged(UFNRInventoryItem* Item)
+{
+	// Only a change to an equipped stack, or a whole new item list, can take an equipped item out of the inventory
+	if (IsValid(Item) && !IsEquipped(Item))
+		return;
+
+	const int32 Removed = EquippedItems.RemoveAll([this](const FEquippedItem& Equipped)
+	{
+		return !IsValid(Equipped.Item) || Equipped.Item->GetOwningInventory() != Inventory;
+	});
+
+	if (Removed > 0)
+	{
+		OnEquipmentChanged();
+	}
+}
+
+void UFNREquipmentComponent::OnEquipmentChanged()
+{
+	EquippedSummary.Reset(EquippedItems.Num());
+	for (const FEquippedItem& Equipped : EquippedItems)
+	{
+		FEquippedItemSummary& Summary = EquippedSummary.AddDefaulted_GetRef();
+		Summary.Slot = Equipped.Slot;
+		Summary.ItemClass = Equipped.Item->GetClass();
+	}
+
+	bStatsDirty = true;
+	OnEquipmentUpdated.Broadcast();
+}
+
+void UFNREquipmentComponent::RebuildStatCache() const
+{
+	CachedStats.Reset();
+
+	for (const FEquippedItem& Equipped : EquippedItems)
+	{
+		if (!IsValid(Equipped.Item))
+			continue;
+
+		for (const FItemStatModifier& Modifier : Equipped.Item->StatModifiers)
+		{
+			FItemStatModifier* Aggregate = CachedStats.Find(Modifier.Stat);
+			if (!Aggregate)
+			{
+				Aggregate = &CachedStats.Add(Modifier.Stat);
+				Aggregate->Stat = Modifier.Stat;
+			}
+
+			Aggregate->Additive += Modifier.Additive;
+			Aggregate->Multiplier *= Modifier.Multiplier;
+		}
+	}
+
+	bStatsDirty = false;
+}
+
+/*
+ * Helpers
+ */
+
+UFNRInventoryItem* UFNREquipmentComponent::GetEquippedItem(const FName Slot) const
+{
+	for (const FEquippedItem& Equipped : EquippedItems)
+	{
+		if (Equipped.Slot == Slot)
+		{
+			return Equipped.Item;
+		}
+	}
+
+	return nullptr;
+}
+
+TSubclassOf<UFNRInventoryItem> UFNREquipmentComponent::GetEquippedItemClass(const FName Slot) const
+{
+	if (const UFNRInventoryItem* Item = GetEquippedItem(Slot))
+		return Item->GetClass();
+
+	for (const FEquippedItemSummary& Summary : EquippedSummary)
+	{
+		if (Summary.Slot == Slot)
+		{
+			return Summary.ItemClass;
+		}
+	}
+
+	return nullptr;
+}
+
+bool UFNREquipmentComponent::IsEquipped(const UFNRInventoryItem* Item) const
+{
+	return EquippedItems.ContainsByPredicate([Item](const FEquippedItem& Equipped)
+	{
+		return Equipped.Item == Item;
+	});
+}
+
+float UFNREquipmentComponent::GetStatValue(const FName Stat, const float BaseValue) const
+{
+	if (bStatsDirty)
+	{
+		RebuildStatCache();
+	}
+
+	if (const FItemStatModifier* Modifier = CachedStats.Find(Stat))
+		return (BaseValue + Modifier->Additive) * Modifier->Multiplier;
+
+	return BaseValue;
+}
@@ -3,15 +3,40 @@
 
 #include "Core/FNRInventoryComponent.h"
 
+#include "Algo/BinarySearch.h"
+#include "Algo/StableSort.h"
+#include "Audit/FNRAuditLogSubsystem.h"
 #include "Components/CapsuleComponent.h"
 #include "Core/FNRInventoryItem.h"
 #include "Engine/ActorChannel.h"
+#include "Expiry/FNRExpirySubsystem.h"
 #include "GameFramework/Character.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerState.h"
 #include "Net/UnrealNetwork.h"
+#include "Storage/FNRStashComponent.h"
 #include "Utils/RbsPickupInterface.h"
 
 #define LOCTEXT_NAMESPACE "Inventory"
 
+namespace
+{
+	//Controller of whoever the inventory belongs to, whether it sits on the pawn, the controller or the player state
+	AController* GetOwningController(AActor* Owner)
+	{
+		if (const APawn* Pawn = Cast<APawn>(Owner))
+			return Pawn->GetController();
+
+		if (const APlayerState* PlayerState = Cast<APlayerState>(Owner))
+			return PlayerState->GetOwningController();
+
+		if (AController* Controller = Cast<AController>(Owner))
+			return Controller;
+
+		return Owner ? Owner->GetInstigatorController() : nullptr;
+	}
+}
+
 UFNRInventoryComponent::UFNRInventoryComponent()
 {
 	PrimaryComponentTick.bCanEverTick = false;
@@ -27,6 +52,8 @@ void UFNRInventoryComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
 	DOREPLIFETIME(UFNRInventoryComponent, Items);
+	DOREPLIFETIME(UFNRInventoryComponent, SortMode);
+	DOREPLIFETIME_CONDITION(UFNRInventoryComponent, LastAckedPredictionKey, COND_OwnerOnly);
 }
 
 bool UFNRInventoryComponent::ReplicateSubobjects(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags)
@@ -38,7 +65,8 @@ bool UFNRInventoryComponent::ReplicateSubobjects(UActorChannel* Channel, FOutBun
 	{
 		for (auto& Item : Items)
 		{
-			if (Channel->KeyNeedsToReplicate(Item->GetUniqueID(), Item->RepKey))
+			// Keyed on a dedicated counter rather than GetUniqueID, which is reused once an item is destroyed
+			if (Channel->KeyNeedsToReplicate(Item->SubobjectKey, Item->RepKey))
 			{
 				bWroteSomething |= Channel->ReplicateSubobject(Item, *Bunch, *RepFlags);
 			}
@@ -48,28 +76,256 @@ bool UFNRInventoryComponent::ReplicateSubobjects(UActorChannel* Channel, FOutBun
 	return bWroteSomething;
 }
 
+/*
+ * Sorting
+ */
+
+void UFNRInventoryComponent::SetSortMode(const EInventorySortMode NewSortMode)
+{
+	if (GetOwnerRole() < ROLE_Authority)
+	{
+		ServerSetSortMode(NewSortMode);
+		return;
+	}
+
+	if (SortMode == NewSortMode)
+		return;
+
+	SortMode = NewSortMode;
+
+	if (SortMode != EInventorySortMode::ISM_None)
+	{
+		Algo::StableSort(Items, [this](const UFNRInventoryItem* A, const UFNRInventoryItem* B)
+		{
+			return SortPredicate(A, B, SortMode);
+		});
+	}
+
+	RebuildCategoryBuckets();
+	OnReplicated_Items();
+}
+
+void UFNRInventoryComponent::ServerSetSortMode_Implementation(const EInventorySortMode NewSortMode)
+{
+	SetSortMode(NewSortMode);
+}
+
+TArray<UFNRInventoryItem*> UFNRInventoryComponent::GetItemsInCategory(const FName CategoryName) const
+{
+	TArray<UFNRInventoryItem*> CategoryItems;
+	GetItemsInCategoryInto(CategoryName, CategoryItems);
+	return CategoryItems;
+}
+
+void UFNRInventoryComponent::GetItemsInCategoryInto(const FName CategoryName, TArray<UFNRInventoryItem*>& OutItems) const
+{
+	const TConstArrayView<TObjectPtr<UFNRInventoryItem>> Bucket = GetCategoryView(CategoryName);
+
+	OutItems.Reset(Bucket.Num());
+	for (UFNRInventoryItem* Item : Bucket)
+	{
+		OutItems.Add(Item);
+	}
+}
+
+TConstArrayView<TObjectPtr<UFNRInventoryItem>> UFNRInventoryComponent::GetCategoryView(const FName CategoryName) const
+{
+	if (const TArray<TObjectPtr<UFNRInventoryItem>>* Bucket = CategoryBuckets.Find(CategoryName))
+		return *Bucket;
+
+	return {};
+}
+
+TArray<FName> UFNRInventoryComponent::GetCategories() const
+{
+	TArray<FName> Categories;
+	CategoryBuckets.GetKeys(Categories);
+	return Categories;
+}
+
+bool UFNRInventoryComponent::SortPredicate(const UFNRInventoryItem* A, const UFNRInventoryItem* B, const EInventorySortMode Mode)
+{
+	// Only per-unit values are compared so quantity changes never move a stack
+	switch (Mode)
+	{
+	case EInventorySortMode::ISM_Category:
+		return A->CategoryName.Compare(B->CategoryName) < 0;
+	case EInventorySortMode::ISM_Weight:
+		return A->Weight > B->Weight;
+	case EInventorySortMode::ISM_Name:
+		return A->DisplayName.CompareTo(B->DisplayName) < 0;
+	case EInventorySortMode::ISM_Value:
+		return A->Value > B->Value;
+	default:
+		return false;
+	}
+}
+
+void UFNRInventoryComponent::InsertSorted(UFNRInventoryItem* Item)
+{
+	TArray<TObjectPtr<UFNRInventoryItem>>& Bucket = CategoryBuckets.FindOrAdd(Item->CategoryName);
+
+	if (SortMode == EInventorySortMode::ISM_None)
+	{
+		Items.Add(Item);
+		Bucket.Add(Item);
+		return;
+	}
+
+	// Upper bound keeps the sort stable: a new stack goes after the ones that compare equal to it
+	auto Predicate = [this](const UFNRInventoryItem* A, const UFNRInventoryItem* B)
+	{
+		return SortPredicate(A, B, SortMode);
+	};
+	Items.Insert(Item, Algo::UpperBound(Items, Item, Predicate));
+	Bucket.Insert(Item, Algo::UpperBound(Bucket, Item, Predicate));
+}
+
+void UFNRInventoryComponent::RemoveFromCategoryBucket(UFNRInventoryItem* Item)
+{
+	if (TArray<TObjectPtr<UFNRInventoryItem>>* Bucket = CategoryBuckets.Find(Item->CategoryName))
+	{
+		Bucket->RemoveSingle(Item);
+		if (Bucket->IsEmpty())
+		{
+			CategoryBuckets.Remove(Item->CategoryName);
+		}
+	}
+}
+
+void UFNRInventoryComponent::RebuildCategoryBuckets()
+{
+	CategoryBuckets.Reset();
+	for (auto& Item : Items)
+	{
+		if (IsValid(Item))
+		{
+			CategoryBuckets.FindOrAdd(Item->CategoryName).Add(Item);
+		}
+	}
+}
+
 /*
  * Behaviour
  */
 
-UFNRInventoryItem* UFNRInventoryComponent::AddItem(UFNRInventoryItem* Item)
+namespace
+{
+	struct FStackableAddPolicy
+	{
+		static constexpr bool bMergeIntoExistingStacks = true;
+		static int32 GetStackSize(const UFNRInventoryItem* Template) { return Template->MaxStackSize; }
+	};
+
+	struct FUniqueAddPolicy
+	{
+		static constexpr bool bMergeIntoExistingStacks = false;
+		static int32 GetStackSize(const UFNRInventoryItem* Template) { return 1; }
+	};
+}
+
+UFNRInventoryItem* UFNRInventoryComponent::AddItem(const UFNRInventoryItem* Template, const int32 StackQuantity, const FItemInstanceState& InstanceState, const double ExpireTime)
 {
 	if (GetOwner()->GetLocalRole() < ROLE_Authority)
 		return nullptr;
 
-	UFNRInventoryItem* NewItem = NewObject<UFNRInventoryItem>(GetOwner(), Item->GetClass());
-	NewItem->SetQuantity(Item->GetQuantity());
-	NewItem->OwningInventory = this;
-	NewItem->AddedToInventory(this);
-	Items.Add(NewItem);
+	UFNRInventoryItem* NewItem = CreateStack(Template->GetClass(), StackQuantity, InstanceState);
+	NewItem->ExpireTime = ExpireTime;
+	ScheduleExpiry(NewItem);
+	RecordAudit(EInventoryAuditAction::IAA_Add, NewItem, StackQuantity);
 	OnReplicated_Items();
 	NewItem->MarkDirtyForReplication();
+	OnItemChanged.Broadcast(NewItem);
+
+	return NewItem;
+}
+
+UFNRInventoryItem* UFNRInventoryComponent::CreateStack(TSubclassOf<UFNRInventoryItem> ItemClass, const int32 StackQuantity, const FItemInstanceState& InstanceState, const int64 ItemId)
+{
+	UFNRInventoryItem* NewItem = NewObject<UFNRInventoryItem>(GetOwner(), ItemClass);
+	NewItem->ItemId = ItemId != 0 && !ItemsById.Contains(ItemId) ? ItemId : UFNRInventoryItem::GenerateItemId();
+	ItemsById.Add(NewItem->ItemId, NewItem);
+	NewItem->SubobjectKey = UFNRInventoryItem::GenerateSubobjectKey();
+	NewItem->Quantity = StackQuantity;
+	NewItem->InstanceState = InstanceState;
+	NewItem->OwningInventory = this;
+	NewItem->AddedToInventory(this);
+	InsertSorted(NewItem);
 
 	NewItem->OnItemModified.AddDynamic(this, &ThisClass::OnItemModified_Internal);
 
 	return NewItem;
 }
 
+void UFNRInventoryComponent::ImportStacks(TConstArrayView<FItemStackRecord> Stacks)
+{
+	if (GetOwnerRole() < ROLE_Authority)
+		return;
+
+	PrepareForAdd();
+
+	Items.Reserve(Items.Num() + Stacks.Num());
+
+	for (const FItemStackRecord& Stack : Stacks)
+	{
+		if (!Stack.ItemClass || Stack.Quantity <= 0)
+			continue;
+
+		UFNRInventoryItem* NewItem = CreateStack(Stack.ItemClass, Stack.Quantity, Stack.InstanceState, Stack.ItemId);
+		++NewItem->RepKey;
+		RecordAudit(EInventoryAuditAction::IAA_Import, NewItem, NewItem->GetQuantity());
+
+		const double RecordExpireTime = GetRecordExpireTime(Stack);
+		NewItem->ExpireTime = RecordExpireTime > 0.0 ? RecordExpireTime : GetNewStackExpireTime(NewItem);
+		ScheduleExpiry(NewItem);
+	}
+
+	ReplicatedItemsKey++;
+	OnReplicated_Items();
+	OnItemChanged.Broadcast(nullptr);
+}
+
+void UFNRInventoryComponent::PrepareForAdd()
+{
+	if (GetOwnerRole() < ROLE_Authority)
+		return;
+
+	OnPreAddItems.Broadcast();
+}
+
+void UFNRInventoryComponent::ExportStacks(TArray<FItemStackRecord>& OutStacks) const
+{
+	OutStacks.Reset(Items.Num());
+
+	ForEachItem([this, &OutStacks](const UFNRInventoryItem* Item)
+	{
+		FItemStackRecord& Stack = OutStacks.Add_GetRef(MakeStackRecord(Item, Item->GetQuantity()));
+		Stack.ItemId = Item->ItemId;
+	});
+}
+
+void UFNRInventoryComponent::ClearItems()
+{
+	if (GetOwnerRole() < ROLE_Authority)
+		return;
+
+	ForEachItem([this](UFNRInventoryItem* Item)
+	{
+		RecordAudit(EInventoryAuditAction::IAA_Clear, Item, Item->GetQuantity());
+		Item->OnItemModified.RemoveAll(this);
+		Item->OwningInventory = nullptr;
+		++Item->RepKey;
+	});
+
+	Items.Reset();
+	ItemsById.Reset();
+	CategoryBuckets.Reset();
+
+	ReplicatedItemsKey++;
+	OnReplicated_Items();
+	OnItemChanged.Broadcast(nullptr);
+}
+
 FItemAddResult UFNRInventoryComponent::TryAddItem(UFNRInventoryItem* Item)
 {
 	return TryAddItem_Internal(Item);
@@ -77,69 +333,147 @@ FItemAddResult UFNRInventoryComponent::TryAddItem(UFNRInventoryItem* Item)
 
 FItemAddResult UFNRInventoryComponent::TryAddItemFromClass(TSubclassOf<UFNRInventoryItem> ItemClass, const int32 Quantity)
 {
-	UFNRInventoryItem* Item = NewObject<UFNRInventoryItem>(GetOwner(), ItemClass);
-	Item->SetQuantity(Quantity);
-	
-	return TryAddItem_Internal(Item);
+	if (!ItemClass)
+		return FItemAddResult::AddedNone(Quantity, LOCTEXT("InventoryErrorText", "Couldn't add any item"));
+
+	// The class defaults are enough to shape the new stacks, no need to spawn a throwaway item
+	return TryAddItem_Internal(GetDefault<UFNRInventoryItem>(ItemClass), Quantity);
 }
 
 FItemAddResult UFNRInventoryComponent::TryAddItem_Internal(UFNRInventoryItem* Item)
+{
+	if (!IsValid(Item))
+		return FItemAddResult::AddedNone(0, LOCTEXT("InventoryErrorText", "Couldn't add any item"));
+
+	return TryAddItem_Internal(Item, Item->GetQuantity());
+}
+
+FItemAddResult UFNRInventoryComponent::TryAddStack(const FItemStackRecord& Stack)
+{
+	if (!Stack.ItemClass || Stack.Quantity <= 0)
+		return FItemAddResult::AddedNone(Stack.Quantity, LOCTEXT("InventoryErrorText", "Couldn't add any item"));
+
+	if (GetOwnerRole() < ROLE_Authority)
+		return FItemAddResult::AddedNone(Stack.Quantity, LOCTEXT("InventoryCallingFunctionsFromClient", "ERROR | You're trying to add items from a client"));
+
+	const UFNRInventoryItem* Template = GetDefault<UFNRInventoryItem>(Stack.ItemClass);
+	const double RecordExpireTime = GetRecordExpireTime(Stack);
+
+	return TryAddItem_Internal(Template, Stack.Quantity, Stack.InstanceState, RecordExpireTime > 0.0 ? RecordExpireTime : GetNewStackExpireTime(Template));
+}
+
+FItemStackRecord UFNRInventoryComponent::MakeStackRecord(const UFNRInventoryItem* Item, const int32 Quantity) const
+{
+	FItemStackRecord Stack;
+	Stack.ItemClass = Item->GetClass();
+	Stack.Quantity = Quantity;
+	Stack.InstanceState = Item->InstanceState;
+
+	if (Item->ExpireTime > 0.0)
+	{
+		Stack.ExpiresAtUtc = FDateTime::UtcNow() + FTimespan::FromSeconds(Item->ExpireTime - GetWorld()->GetTimeSeconds());
+	}
+
+	return Stack;
+}
+
+double UFNRInventoryComponent::GetRecordExpireTime(const FItemStackRecord& Stack) const
+{
+	if (Stack.ExpiresAtUtc.GetTicks() <= 0)
+		return 0.0;
+
+	// Records that expired while stored still get a positive ExpireTime, so they expire on the next tick instead of never
+	const double Remaining = (Stack.ExpiresAtUtc - FDateTime::UtcNow()).GetTotalSeconds();
+	return GetWorld()->GetTimeSeconds() + FMath::Max(Remaining, static_cast<double>(KINDA_SMALL_NUMBER));
+}
+
+FItemAddResult UFNRInventoryComponent::TryAddItem_Internal(const UFNRInventoryItem* Template, const int32 Quantity)
+{
+	return TryAddItem_Internal(Template, Quantity, Template->InstanceState, GetNewStackExpireTime(Template));
+}
+
+FItemAddResult UFNRInventoryComponent::TryAddItem_Internal(const UFNRInventoryItem* Template, const int32 Quantity, const FItemInstanceState& InstanceState, const double ExpireTime)
 {
 	if (GetOwner()->GetLocalRole() < ROLE_Authority)
-		return FItemAddResult::AddedNone(Item->GetQuantity(), LOCTEXT("InventoryCallingFunctionsFromClient", "ERROR | You're trying to add items from a client"));;
+		return FItemAddResult::AddedNone(Quantity, LOCTEXT("InventoryCallingFunctionsFromClient", "ERROR | You're trying to add items from a client"));
 
-	const int32 AddAmount = Item->GetQuantity();
-	if (Items.Num() + 1 > GetCapacity())
-		return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryCapacityFullText", "Inventory Is Full"));
+	PrepareForAdd();
+
+	if (Template->IsUnique())
+		return TryAddItem_Impl<FUniqueAddPolicy>(Template, Quantity, InstanceState, ExpireTime);
+
+	return TryAddItem_Impl<FStackableAddPolicy>(Template, Quantity, InstanceState, ExpireTime);
+}
 
-	if (GetCurrentWeight() + Item->Weight > GetWeightCapacity())
+template <typename TAddPolicy>
+FItemAddResult UFNRInventoryComponent::TryAddItem_Impl(const UFNRInventoryItem* Template, const int32 AddAmount, const FItemInstanceState& InstanceState, const double ExpireTime)
+{
+	// Unique items always need a free slot, stackable ones may still fit into existing stacks
+	if constexpr (!TAddPolicy::bMergeIntoExistingStacks)
+	{
+		if (Items.Num() + 1 > GetCapacity())
+			return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryCapacityFullText", "Inventory Is Full"));
+	}
+
+	const float CurrentWeight = GetCurrentWeight();
+	if (CurrentWeight + Template->Weight > GetWeightCapacity())
 		return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryTooMuchWeightText", "Too Much Weight"));
-	
-	const int32 WeightMaxAddAmount = FMath::FloorToInt((WeightCapacity - GetCurrentWeight()) / Item->Weight);
-	int32 ActualAddAmount = FMath::Min(AddAmount, WeightMaxAddAmount);
+
+	int32 ActualAddAmount = AddAmount;
+	if (Template->Weight > 0.f)
+	{
+		const int32 WeightMaxAddAmount = FMath::FloorToInt((WeightCapacity - CurrentWeight) / Template->Weight);
+		ActualAddAmount = FMath::Min(ActualAddAmount, WeightMaxAddAmount);
+	}
+
 	if (ActualAddAmount <= 0)
 		return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryErrorText", "Couldn't add any item"));
-	
-	if (Item->bStackable)
+
+	UFNRInventoryItem* LastStack = nullptr;
+	int32 RemainingAmount = ActualAddAmount;
+
+	if constexpr (TAddPolicy::bMergeIntoExistingStacks)
 	{
-		auto ExistingItems = FindItems(Item);
-		for (auto Temp : ExistingItems)
+		for (auto& Existing : Items)
 		{
-			if (Temp->GetQuantity() >= Temp->MaxStackSize)
-				continue;
-    			
-			const int32 StackAddAmount = FMath::Min(ActualAddAmount, Temp->MaxStackSize - Temp->GetQuantity());
-			if (StackAddAmount <= 0)
+			if (RemainingAmount <= 0)
+				break;
+
+			if (Existing->GetClass() != Template->GetClass() || Existing->IsStackFull())
 				continue;
-    			
-			Temp->SetQuantity(Temp->GetQuantity() + StackAddAmount);
-			Item->SetQuantity(Item->GetQuantity() - StackAddAmount);
-			ActualAddAmount -= StackAddAmount;
+
+			const int32 StackAddAmount = FMath::Min(RemainingAmount, Existing->MaxStackSize - Existing->GetQuantity());
+			Existing->SetQuantity(Existing->GetQuantity() + StackAddAmount);
+
+			// A merged stack expires along with its oldest units
+			if (ExpireTime > 0.0 && (Existing->ExpireTime <= 0.0 || ExpireTime < Existing->ExpireTime))
+			{
+				Existing->SetExpireTime(ExpireTime);
+			}
+
+			RecordAudit(EInventoryAuditAction::IAA_Add, Existing, StackAddAmount);
+			RemainingAmount -= StackAddAmount;
+			LastStack = Existing;
 		}
 	}
-    
-	if (ActualAddAmount > 0)
+
+	const int32 StackSize = TAddPolicy::GetStackSize(Template);
+	while (RemainingAmount > 0 && Items.Num() < GetCapacity())
 	{
-		const int32 StacksToAdd = FMath::CeilToInt(float(ActualAddAmount) / float(Item->MaxStackSize));
-		for (size_t i = 0; i < StacksToAdd; i++)
-		{
-			if (ActualAddAmount <= 0)
-				break;
-    				
-			const int32 StackAddAmount = FMath::Min(ActualAddAmount, Item->MaxStackSize);
-			if (StackAddAmount <= 0)
-				continue;
-    				
-			ActualAddAmount -= StackAddAmount;
-			Item->SetQuantity(StackAddAmount);
-			AddItem(Item);
-		}
+		const int32 StackAddAmount = FMath::Min(RemainingAmount, StackSize);
+		LastStack = AddItem(Template, StackAddAmount, InstanceState, ExpireTime);
+		RemainingAmount -= StackAddAmount;
 	}
 
-	if (ActualAddAmount > 0)
-		return FItemAddResult::AddedSome(Item, AddAmount, ActualAddAmount, LOCTEXT("InventoryAddedSomeText", "Couldn't add all items"));
-    		
-	return FItemAddResult::AddedAll(Item, AddAmount);
+	ActualAddAmount -= RemainingAmount;
+
+	if (ActualAddAmount <= 0)
+		return FItemAddResult::AddedNone(AddAmount, LOCTEXT("InventoryCapacityFullText", "Inventory Is Full"));
+
+	if (ActualAddAmount < AddAmount)
+		return FItemAddResult::AddedSome(LastStack, AddAmount, ActualAddAmount, LOCTEXT("InventoryAddedSomeText", "Couldn't add all items"));
+
+	return FItemAddResult::AddedAll(LastStack, AddAmount);
 }
 
 bool UFNRInventoryComponent::RemoveItem(UFNRInventoryItem* Item)
@@ -147,14 +481,22 @@ bool UFNRInventoryComponent::RemoveItem(UFNRInventoryItem* Item)
 	if (GetOwnerRole() < ROLE_Authority)
 		return false;
 
-	if (!IsValid(Item))
+	if (!OwnsItem(Item))
 		return false;
 
+	if (Item->GetQuantity() > 0)
+	{
+		RecordAudit(EInventoryAuditAction::IAA_Remove, Item, Item->GetQuantity());
+	}
+
 	Item->OwningInventory = nullptr;
 	Items.RemoveSingle(Item);
+	ItemsById.Remove(Item->ItemId);
+	RemoveFromCategoryBucket(Item);
 	Item->MarkDirtyForReplication();
 	
 	OnReplicated_Items();
+	OnItemChanged.Broadcast(Item);
 	
 	ReplicatedItemsKey++;
 	
@@ -172,11 +514,17 @@ int32 UFNRInventoryComponent::ConsumeItem(UFNRInventoryItem* Item)
 }
 
 int32 UFNRInventoryComponent::ConsumeItem(UFNRInventoryItem* Item, const int32 Quantity)
+{
+	return ConsumeItem_Internal(Item, Quantity, EInventoryAuditAction::IAA_Consume);
+}
+
+int32 UFNRInventoryComponent::ConsumeItem_Internal(UFNRInventoryItem* Item, const int32 Quantity, const EInventoryAuditAction Action)
 {
 	if (GetOwner()->GetLocalRole() < ROLE_Authority)
-		return 0;
+		return ActivePredictionKey != 0 ? PredictConsume(Item, Quantity) : 0;
 
-	if (!IsValid(Item))
+	// A negative quantity would add items, only ever consume from our own stacks
+	if (!OwnsItem(Item) || Quantity <= 0)
 		return 0;
 
 	const int32 RemoveQuantity = FMath::Min(Quantity, Item->GetQuantity());
@@ -184,6 +532,7 @@ int32 UFNRInventoryComponent::ConsumeItem(UFNRInventoryItem* Item, const int32 Q
 	ensure(!(Item->GetQuantity() - RemoveQuantity < 0));
 
 	Item->SetQuantity(Item->GetQuantity() - RemoveQuantity);
+	RecordAudit(Action, Item, RemoveQuantity);
 
 	if (Item->GetQuantity() <= 0)
 	{
@@ -197,14 +546,64 @@ int32 UFNRInventoryComponent::ConsumeItem(UFNRInventoryItem* Item, const int32 Q
 	return RemoveQuantity;
 }
 
+void UFNRInventoryComponent::ExpireItems(TConstArrayView<UFNRInventoryItem*> ExpiredItems)
+{
+	if (GetOwnerRole() < ROLE_Authority)
+		return;
+
+	for (UFNRInventoryItem* Item : ExpiredItems)
+	{
+		if (!OwnsItem(Item) || Item->ExpireTime <= 0.0)
+			continue;
+
+		// Reset first, so the stack only expires again if Expire gives it a new time
+		Item->SetExpireTime(0.0);
+		Item->Expire(this);
+	}
+}
+
+int32 UFNRInventoryComponent::ConsumeItemsOfClass(TSubclassOf<UFNRInventoryItem> ItemClass, const int32 Quantity)
+{
+	if (GetOwner()->GetLocalRole() < ROLE_Authority)
+		return 0;
+
+	int32 Consumed = 0;
+
+	// Walk backwards, emptied stacks are removed from Items as we go
+	for (int32 Index = Items.Num() - 1; Index >= 0 && Consumed < Quantity; --Index)
+	{
+		UFNRInventoryItem* Item = Items[Index];
+		if (IsValid(Item) && Item->GetClass() == ItemClass)
+		{
+			Consumed += ConsumeItem(Item, Quantity - Consumed);
+		}
+	}
+
+	return Consumed;
+}
+
 void UFNRInventoryComponent::UseItem(UFNRInventoryItem* Item)
 {
+	if (IsPredicting())
+	{
+		if (!IsValid(Item) || Item->GetPredictedQuantity() <= 0)
+			return;
+
+		const int32 PredictionKey = ++NextPredictionKey;
+		ServerUseItem(Item->ItemId, PredictionKey);
+
+		// Any ConsumeItem the item does while being used is recorded against this key
+		TGuardValue<int32> PredictionScope(ActivePredictionKey, PredictionKey);
+		Item->Use(this);
+		return;
+	}
+
 	if (GetOwnerRole() < ROLE_Authority)
-		ServerUseItem(Item);
+		ServerUseItem(IsValid(Item) ? Item->ItemId : 0, 0);
 
 	if (GetOwner()->GetLocalRole() >= ROLE_Authority)
 	{
-		if (!IsValid(FindItem(Item)))
+		if (!OwnsItem(Item))
 			return;
 	}
 
@@ -214,23 +613,53 @@ void UFNRInventoryComponent::UseItem(UFNRInventoryItem* Item)
 	}
 }
 
-void UFNRInventoryComponent::ServerUseItem_Implementation(UFNRInventoryItem* Item)
+void UFNRInventoryComponent::ServerUseItem_Implementation(const int64 ItemId, const int32 PredictionKey)
 {
-	UseItem(Item);
+	// Only stacks in our own id map resolve, so a client can't name an item it doesn't own
+	if (UFNRInventoryItem* Item = FindItemById(ItemId))
+	{
+		UseItem(Item);
+	}
+	else
+	{
+		RecordAudit(EInventoryAuditAction::IAA_Rejected, nullptr, 0);
+	}
+
+	AckPrediction(PredictionKey);
 }
 
 void UFNRInventoryComponent::DropItem(UFNRInventoryItem* Item, const int32 Quantity)
 {
-	if (!IsValid(FindItem(Item)))
+	if (!OwnsItem(Item) || Quantity <= 0)
 		return;
 
 	if (GetOwnerRole() < ROLE_Authority)
 	{
-		ServerDropItem(Item, Quantity);
+		if (!IsPredicting())
+		{
+			ServerDropItem(Item->ItemId, Quantity, 0);
+			return;
+		}
+
+		if (Item->GetPredictedQuantity() <= 0)
+			return;
+
+		const int32 PredictionKey = ++NextPredictionKey;
+		ServerDropItem(Item->ItemId, Quantity, PredictionKey);
+
+		TGuardValue<int32> PredictionScope(ActivePredictionKey, PredictionKey);
+		ConsumeItem(Item, Quantity);
 		return;
 	}
 	
-	const int32 DroppedQuantity = ConsumeItem(Item, Quantity);
+	// Taken before consuming, the item may be gone afterwards
+	FItemStackRecord DroppedStack = MakeStackRecord(Item, 0);
+
+	const int32 DroppedQuantity = ConsumeItem_Internal(Item, Quantity, EInventoryAuditAction::IAA_Drop);
+	if (DroppedQuantity <= 0)
+		return;
+
+	DroppedStack.Quantity = DroppedQuantity;
 
 	FActorSpawnParameters SpawnParams;
 	SpawnParams.Owner = GetOwner();
@@ -246,31 +675,299 @@ void UFNRInventoryComponent::DropItem(UFNRInventoryItem* Item, const int32 Quant
 
 	AActor* Pickup = GetWorld()->SpawnActor<AActor>(Item->PickupClass.LoadSynchronous(), SpawnTransform, SpawnParams);
 	IRbsPickupInterface::Execute_SetPickupQuantity(Pickup, DroppedQuantity);
+	IRbsPickupInterface::Execute_SetPickupStack(Pickup, DroppedStack);
 	IRbsPickupInterface::Execute_OnDropItem(Pickup);
 }
 
-void UFNRInventoryComponent::ServerDropItem_Implementation(UFNRInventoryItem* Item, const int32 Quantity)
+void UFNRInventoryComponent::ServerDropItem_Implementation(const int64 ItemId, const int32 Quantity, const int32 PredictionKey)
 {
-	DropItem(Item, Quantity);
+	UFNRInventoryItem* Item = FindItemById(ItemId);
+	if (IsValid(Item) && Quantity > 0)
+	{
+		DropItem(Item, Quantity);
+	}
+	else
+	{
+		RecordAudit(EInventoryAuditAction::IAA_Rejected, Item, Quantity);
+	}
+
+	AckPrediction(PredictionKey);
+}
+
+void UFNRInventoryComponent::TransferItem(UFNRInventoryComponent* From, UFNRInventoryComponent* To, const int64 ItemId, const int32 Quantity)
+{
+	if (GetOwnerRole() < ROLE_Authority)
+	{
+		ServerTransferItem(From, To, ItemId, Quantity);
+		return;
+	}
+
+	if (!IsValid(From) || !IsValid(To) || From == To || (From != this && To != this) || Quantity <= 0)
+	{
+		RecordAudit(EInventoryAuditAction::IAA_Rejected, nullptr, Quantity);
+		return;
+	}
+
+	UFNRInventoryItem* Item = From->FindItemById(ItemId);
+	if (!IsValid(Item))
+	{
+		RecordAudit(EInventoryAuditAction::IAA_Rejected, nullptr, Quantity);
+		return;
+	}
+
+	// Add first, then take out of From exactly what To accepted
+	const FItemAddResult Result = To->TryAddItem_Internal(Item, FMath::Min(Quantity, Item->GetQuantity()));
+	if (Result.AmountGiven <= 0)
+		return;
+
+	From->ConsumeItem_Internal(Item, Result.AmountGiven, EInventoryAuditAction::IAA_Transfer);
+}
+
+void UFNRInventoryComponent::ServerTransferItem_Implementation(UFNRInventoryComponent* From, UFNRInventoryComponent* To, const int64 ItemId, const int32 Quantity)
+{
+	// Clients may move their own items into a container they can reach, or pull from one. Never from anybody else's inventory
+	UFNRInventoryComponent* Container = From == this ? To : From;
+	if ((From != this && To != this) || !CanAccessContainer(Container))
+	{
+		RecordAudit(EInventoryAuditAction::IAA_Rejected, nullptr, Quantity);
+		return;
+	}
+
+	TransferItem(From, To, ItemId, Quantity);
+}
+
+bool UFNRInventoryComponent::CanAccessContainer(const UFNRInventoryComponent* Container) const
+{
+	if (!IsValid(Container) || Container == this)
+		return false;
+
+	AController* Controller = GetOwningController(GetOwner());
+	if (!IsValid(Controller))
+		return false;
+
+	// Stashes have to be opened by this player first
+	if (const UFNRStashComponent* Stash = Container->GetOwner()->FindComponentByClass<UFNRStashComponent>())
+		return Stash->IsOpenedBy(Controller);
+
+	const AController* ContainerController = GetOwningController(Container->GetOwner());
+	if (ContainerController == Controller)
+		return true;
+
+	if (IsValid(ContainerController) && ContainerController->IsPlayerController())
+		return false;
+
+	// Loose containers and AI loadouts only need to be within reach
+	const APawn* Pawn = Controller->GetPawn();
+	return IsValid(Pawn) && FVector::DistSquared(Pawn->GetActorLocation(), Container->GetOwner()->GetActorLocation()) <= FMath::Square(MaxContainerAccessDistance);
 }
 
 void UFNRInventoryComponent::OnItemModified_Internal()
 {
+	NotifyInventoryUpdated();
+}
+
+/*
+ * Prediction
+ */
+
+bool UFNRInventoryComponent::IsPredicting() const
+{
+	return bUsePrediction && GetOwnerRole() < ROLE_Authority;
+}
+
+TArray<UFNRInventoryItem*> UFNRInventoryComponent::GetPredictedItems() const
+{
+	const TConstArrayView<TObjectPtr<UFNRInventoryItem>> View = GetPredictedItemsView();
+
+	TArray<UFNRInventoryItem*> VisibleItems;
+	VisibleItems.Reserve(View.Num());
+	for (UFNRInventoryItem* Item : View)
+	{
+		VisibleItems.Add(Item);
+	}
+
+	return VisibleItems;
+}
+
+TConstArrayView<TObjectPtr<UFNRInventoryItem>> UFNRInventoryComponent::GetPredictedItemsView() const
+{
+	if (IsPredicting())
+		return PredictedItems;
+
+	return Items;
+}
+
+int32 UFNRInventoryComponent::PredictConsume(UFNRInventoryItem* Item, const int32 Quantity)
+{
+	if (!IsValid(Item))
+		return 0;
+
+	const int32 PredictedQuantity = FMath::Min(Quantity, Item->GetPredictedQuantity());
+	if (PredictedQuantity <= 0)
+		return 0;
+
+	FItemPrediction& Prediction = PendingPredictions.AddDefaulted_GetRef();
+	Prediction.PredictionKey = ActivePredictionKey;
+	Prediction.Item = Item;
+	Prediction.Quantity = PredictedQuantity;
+
+	ReconcilePredictions();
+
+	return PredictedQuantity;
+}
+
+void UFNRInventoryComponent::AckPrediction(const int32 PredictionKey)
+{
+	// Rejected predictions are acknowledged too, the client rolls back by falling back to the replicated state
+	if (PredictionKey > LastAckedPredictionKey)
+	{
+		LastAckedPredictionKey = PredictionKey;
+	}
+}
+
+void UFNRInventoryComponent::ReconcilePredictions()
+{
+	PendingPredictions.RemoveAll([this](const FItemPrediction& Prediction)
+	{
+		return Prediction.PredictionKey <= LastAckedPredictionKey || !Prediction.Item.IsValid() || !Items.Contains(Prediction.Item.Get());
+	});
+
+	for (auto& Item : Items)
+	{
+		if (IsValid(Item))
+		{
+			Item->PredictedQuantityDelta = 0;
+		}
+	}
+
+	for (const FItemPrediction& Prediction : PendingPredictions)
+	{
+		Prediction.Item->PredictedQuantityDelta -= Prediction.Quantity;
+	}
+
+	uint32 StateHash = 0;
+	PredictedItems.Reset();
+	for (auto& Item : Items)
+	{
+		// Items replicate before their subobjects resolve, so entries can still be null here
+		if (!IsValid(Item) || Item->GetPredictedQuantity() <= 0)
+			continue;
+
+		PredictedItems.Add(Item);
+		StateHash = HashCombine(StateHash, HashCombine(GetTypeHash(Item.Get()), GetTypeHash(Item->GetPredictedQuantity())));
+	}
+
+	if (StateHash != PredictedStateHash)
+	{
+		PredictedStateHash = StateHash;
+		OnInventoryUpdated.Broadcast();
+	}
+}
+
+void UFNRInventoryComponent::NotifyInventoryUpdated()
+{
+	if (IsPredicting())
+	{
+		ReconcilePredictions();
+		return;
+	}
+
 	OnInventoryUpdated.Broadcast();
 }
 
+void UFNRInventoryComponent::OnRep_LastAckedPredictionKey()
+{
+	if (IsPredicting())
+	{
+		ReconcilePredictions();
+	}
+}
+
 /*
  * Helpers
  */
 
+FName UFNRInventoryComponent::GetAuditId() const
+{
+	if (!CachedAuditId.IsNone())
+		return CachedAuditId;
+
+	AActor* Owner = GetOwner();
+
+	if (const UFNRStashComponent* Stash = Owner->FindComponentByClass<UFNRStashComponent>(); Stash && !Stash->GetStashId().IsNone())
+		return CachedAuditId = FName(*FString::Printf(TEXT("Stash:%s"), *Stash->GetStashId().ToString()));
+
+	const AController* Controller = GetOwningController(Owner);
+	const APlayerState* PlayerState = Controller ? Controller->PlayerState.Get() : nullptr;
+	if (PlayerState && PlayerState->GetUniqueId().IsValid())
+		return CachedAuditId = FName(*FString::Printf(TEXT("Player:%s"), *PlayerState->GetUniqueId().ToString()));
+
+	// Neither a player's nor a stash, the actor path at least tells containers apart within a session
+	const FName PathId(*Owner->GetPathName());
+
+	//A pawn nobody possesses yet or a player whose net id isn't known yet may still get a player id, don't pin the path on them
+	const bool bMayBecomePlayer = Controller ? Controller->IsPlayerController() : Owner->IsA<APawn>() || Owner->IsA<APlayerState>();
+	if (!bMayBecomePlayer)
+		CachedAuditId = PathId;
+
+	return PathId;
+}
+
 bool UFNRInventoryComponent::HasItem(TSubclassOf<UFNRInventoryItem> ItemClass, const int32 Quantity) const
 {
-	UFNRInventoryItem* ItemToFind = FindItemByClass(ItemClass);
-	if (IsValid(ItemToFind))
+	return GetItemCount(ItemClass) >= Quantity;
+}
+
+int32 UFNRInventoryComponent::GetItemCount(TSubclassOf<UFNRInventoryItem> ItemClass) const
+{
+	int32 Count = 0;
+
+	ForEachItemOfClass(ItemClass, [&Count](const UFNRInventoryItem* Item)
 	{
-		return ItemToFind->GetQuantity() >= Quantity;
+		Count += Item->GetQuantity();
+	});
+
+	return Count;
+}
+
+UFNRInventoryItem* UFNRInventoryComponent::FindItemById(const int64 ItemId) const
+{
+	if (const TObjectPtr<UFNRInventoryItem>* Item = ItemsById.Find(ItemId))
+		return *Item;
+
+	return nullptr;
+}
+
+bool UFNRInventoryComponent::OwnsItem(const UFNRInventoryItem* Item) const
+{
+	return IsValid(Item) && Item->OwningInventory.Get() == this;
+}
+
+void UFNRInventoryComponent::RecordAudit(const EInventoryAuditAction Action, const UFNRInventoryItem* Item, const int32 Quantity) const
+{
+	if (UFNRAuditLogSubsystem* AuditLog = UWorld::GetSubsystem<UFNRAuditLogSubsystem>(GetWorld()))
+	{
+		AuditLog->Record(this, Action, Item, Quantity);
+	}
+}
+
+void UFNRInventoryComponent::ScheduleExpiry(UFNRInventoryItem* Item) const
+{
+	if (Item->ExpireTime <= 0.0)
+		return;
+
+	if (UFNRExpirySubsystem* ExpirySubsystem = UWorld::GetSubsystem<UFNRExpirySubsystem>(GetWorld()))
+	{
+		ExpirySubsystem->ScheduleExpiry(Item);
 	}
-	return false;
+}
+
+double UFNRInventoryComponent::GetNewStackExpireTime(const UFNRInventoryItem* Template) const
+{
+	if (Template->ExpireTime > 0.0)
+		return Template->ExpireTime;
+
+	return Template->Lifetime > 0.f ? GetWorld()->GetTimeSeconds() + Template->Lifetime : 0.0;
 }
 
 UFNRInventoryItem* UFNRInventoryComponent::FindItem(UFNRInventoryItem* Item) const
@@ -285,39 +982,52 @@ TArray<UFNRInventoryItem*> UFNRInventoryComponent::FindItems(UFNRInventoryItem*
 
 UFNRInventoryItem* UFNRInventoryComponent::FindItemByClass(TSubclassOf<UFNRInventoryItem> ItemClass) const
 {
-	for (auto& Item : Items)
+	return FindItemByPredicate([ItemClass](const UFNRInventoryItem* Item)
 	{
-		if (Item->GetClass() == ItemClass)
-		{
-			return Item;
-		}
-	}
-
-	return nullptr;
+		return Item->GetClass() == ItemClass;
+	});
 }
 
 TArray<UFNRInventoryItem*> UFNRInventoryComponent::FindItemsByClass(TSubclassOf<UFNRInventoryItem> ItemClass) const
 {
-	TArray<UFNRInventoryItem*> ItemsOfClas{};
-	for (auto& Item : Items)
+	TArray<UFNRInventoryItem*> ItemsOfClass;
+	FindItemsByClassInto(ItemClass, ItemsOfClass);
+	return ItemsOfClass;
+}
+
+void UFNRInventoryComponent::FindItemsByClassInto(TSubclassOf<UFNRInventoryItem> ItemClass, TArray<UFNRInventoryItem*>& OutItems) const
+{
+	OutItems.Reset();
+	ForEachItemOfClass(ItemClass, [&OutItems](UFNRInventoryItem* Item)
 	{
-		if (Item->GetClass() == ItemClass)
-		{
-			ItemsOfClas.Add(Item);
-		}
-	}
+		OutItems.Add(Item);
+	});
+}
 
-	return ItemsOfClas;
+TArray<UFNRInventoryItem*> UFNRInventoryComponent::GetItems() const
+{
+	TArray<UFNRInventoryItem*> AllItems;
+	GetItemsInto(AllItems);
+	return AllItems;
+}
+
+void UFNRInventoryComponent::GetItemsInto(TArray<UFNRInventoryItem*>& OutItems) const
+{
+	OutItems.Reset(Items.Num());
+	ForEachItem([&OutItems](UFNRInventoryItem* Item)
+	{
+		OutItems.Add(Item);
+	});
 }
 
 float UFNRInventoryComponent::GetCurrentWeight() const
 {
 	float Weight = 0.f;
 
-	for (auto& Item : Items)
+	ForEachItem([&Weight](const UFNRInventoryItem* Item)
 	{
 		Weight += Item->GetStackWeight();
-	}
+	});
 
 	return Weight;
 }
@@ -336,12 +1046,40 @@ void UFNRInventoryComponent::SetCapacity(const int32 NewCapacity)
 
 void UFNRInventoryComponent::OnReplicated_Items()
 {
-	OnInventoryUpdated.Broadcast();
+	// The server keeps its buckets up to date as items come and go
+	if (GetOwnerRole() < ROLE_Authority)
+	{
+		RebuildCategoryBuckets();
+
+		// OwningInventory isn't replicated, set it locally so the items can report their quantity changes to us
+		ItemsById.Reset();
+		ForEachItem([this](UFNRInventoryItem* Item)
+		{
+			Item->OwningInventory = this;
+			ItemsById.Add(Item->ItemId, Item);
+		});
+
+		OnItemChanged.Broadcast(nullptr);
+	}
+
+	if (IsPredicting())
+	{
+		// Quantity changes only reach the client through the items themselves, reconcile on those as well
+		for (auto& Item : Items)
+		{
+			if (IsValid(Item))
+			{
+				Item->OnItemModified.AddUniqueDynamic(this, &ThisClass::OnItemModified_Internal);
+			}
+		}
+	}
+
+	NotifyInventoryUpdated();
 }
 
 void UFNRInventoryComponent::ClientRefreshInventory_Implementation()
 {
-	OnInventoryUpdated.Broadcast();
+	NotifyInventoryUpdated();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -3,6 +3,8 @@
 #include "Core/FNRInventoryItem.h"
 
 #include "Core/FNRInventoryComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
 #include "Net/UnrealNetwork.h"
 
 #define LOCTEXT_NAMESPACE "Item"
@@ -42,7 +44,10 @@ void UFNRInventoryItem::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& Ou
 {
 	UObject::GetLifetimeReplicatedProps(OutLifetimeProps);
 
+	DOREPLIFETIME_CONDITION(UFNRInventoryItem, ItemId, COND_InitialOnly);
 	DOREPLIFETIME(UFNRInventoryItem, Quantity);
+	DOREPLIFETIME(UFNRInventoryItem, InstanceState);
+	DOREPLIFETIME(UFNRInventoryItem, ExpireTime);
 }
 
 void UFNRInventoryItem::MarkDirtyForReplication()
@@ -55,7 +60,39 @@ void UFNRInventoryItem::MarkDirtyForReplication()
 	}
 }
 
+int64 UFNRInventoryItem::GenerateItemId()
+{
+	check(IsInGameThread());
+
+	static int64 NextItemId = FDateTime::UtcNow().ToUnixTimestamp() << 32;
+	return ++NextItemId;
+}
+
+int32 UFNRInventoryItem::GenerateSubobjectKey()
+{
+	check(IsInGameThread());
+
+	static int32 NextSubobjectKey = 0;
+	NextSubobjectKey = NextSubobjectKey == MAX_int32 ? 1 : NextSubobjectKey + 1;
+	return NextSubobjectKey;
+}
+
 void UFNRInventoryItem::OnRep_Quantity()
+{
+	OnItemModified.Broadcast();
+
+	if (IsValid(OwningInventory))
+	{
+		OwningInventory->OnItemChanged.Broadcast(this);
+	}
+}
+
+void UFNRInventoryItem::OnRep_InstanceState()
+{
+	OnItemModified.Broadcast();
+}
+
+void UFNRInventoryItem::OnRep_ExpireTime()
 {
 	OnItemModified.Broadcast();
 }
@@ -68,6 +105,14 @@ void UFNRInventoryItem::AddedToInventory_Implementation(UFNRInventoryComponent*
 {
 }
 
+void UFNRInventoryItem::Expire_Implementation(UFNRInventoryComponent* Inventory)
+{
+	if (IsValid(Inventory))
+	{
+		Inventory->ConsumeItem(this);
+	}
+}
+
 void UFNRInventoryItem::SetQuantity(const int32 NewQuantity)
 {
 	if (NewQuantity != Quantity)
@@ -79,4 +124,39 @@ void UFNRInventoryItem::SetQuantity(const int32 NewQuantity)
 	}
 }
 
+void UFNRInventoryItem::SetInstanceState(const FItemInstanceState& NewInstanceState)
+{
+	InstanceState = NewInstanceState;
+	OnRep_InstanceState();
+	MarkDirtyForReplication();
+}
+
+void UFNRInventoryItem::SetExpireTime(const double NewExpireTime)
+{
+	if (NewExpireTime == ExpireTime)
+		return;
+
+	ExpireTime = NewExpireTime;
+	OnRep_ExpireTime();
+	MarkDirtyForReplication();
+
+	if (IsValid(OwningInventory))
+	{
+		OwningInventory->ScheduleExpiry(this);
+	}
+}
+
+float UFNRInventoryItem::GetRemainingLifetime() const
+{
+	if (ExpireTime <= 0.0)
+		return -1.f;
+
+	const UWorld* World = GetWorld();
+	const AGameStateBase* GameState = World ? World->GetGameState() : nullptr;
+	if (!GameState)
+		return -1.f;
+
+	return FMath::Max(ExpireTime - GameState->GetServerWorldTimeSeconds(), 0.0);
+}
+
 #undef LOCTEXT_NAMESPACE
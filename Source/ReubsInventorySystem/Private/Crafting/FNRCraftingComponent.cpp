@@ -0,0 +1,277 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Crafting/FNRCraftingComponent.h"
+
+#include "Core/FNRInventoryComponent.h"
+#include "Core/FNRInventoryItem.h"
+#include "Crafting/FNRCraftingRecipe.h"
+#include "Crafting/FNRRecipeBook.h"
+
+UFNRCraftingComponent::UFNRCraftingComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+/*
+ * Behaviour
+ */
+
+void UFNRCraftingComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Inventory = GetOwner()->FindComponentByClass<UFNRInventoryComponent>();
+
+	if (IsValid(Inventory))
+	{
+		ItemChangedHandle = Inventory->OnItemChanged.AddUObject(this, &ThisClass::OnItemChanged);
+	}
+
+	RebuildFeasibility();
+}
+
+void UFNRCraftingComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (IsValid(Inventory))
+	{
+		Inventory->OnItemChanged.Remove(ItemChangedHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool UFNRCraftingComponent::Craft(UFNRCraftingRecipe* Recipe)
+{
+	if (GetOwnerRole() < ROLE_Authority)
+	{
+		ServerCraft(Recipe);
+		return false;
+	}
+
+	if (!IsValid(Recipe) || !IsValid(Inventory) || !IsValid(RecipeBook))
+		return false;
+
+	const int32 RecipeIndex = RecipeBook->GetRecipeIndex(Recipe);
+	if (RecipeIndex == INDEX_NONE || !Recipe->ResultClass)
+		return false;
+
+	// Check everything up front so the craft either fully happens or doesn't touch the inventory
+	const TConstArrayView<FCraftingIngredient> Requirements = RecipeBook->GetRequirements(RecipeIndex);
+	for (const FCraftingIngredient& Ingredient : Requirements)
+	{
+		if (!Inventory->HasItem(Ingredient.ItemClass, Ingredient.Quantity))
+			return false;
+	}
+
+	if (!HasRoomForResult(Recipe, Requirements))
+		return false;
+
+	for (const FCraftingIngredient& Ingredient : Requirements)
+	{
+		Inventory->ConsumeItemsOfClass(Ingredient.ItemClass, Ingredient.Quantity);
+	}
+
+	const FItemAddResult Result = Inventory->TryAddItemFromClass(Recipe->ResultClass, Recipe->ResultQuantity);
+	ensure(Result.Result == EItemAddResult::IAR_AllItemsAdded);
+
+	return true;
+}
+
+void UFNRCraftingComponent::ServerCraft_Implementation(UFNRCraftingRecipe* Recipe)
+{
+	Craft(Recipe);
+}
+
+void UFNRCraftingComponent::OnItemChanged(UFNRInventoryItem* Item)
+{
+	if (!IsValid(RecipeBook))
+		return;
+
+	bool bChanged = false;
+
+	if (IsValid(Item))
+	{
+		const UClass* ItemClass = Item->GetClass();
+		const int32 Count = Inventory->GetItemCount(Item->GetClass());
+
+		int32& CachedCount = ItemCounts.FindOrAdd(ItemClass);
+		if (CachedCount == Count)
+			return;
+
+		CachedCount = Count;
+		bChanged = RefreshRecipesUsing(ItemClass);
+	}
+	else
+	{
+		// Whole item list replaced, recount once and only refresh the classes whose totals moved
+		TMap<TObjectKey<UClass>, int32> NewCounts;
+		Inventory->ForEachItem([&NewCounts](const UFNRInventoryItem* Stack)
+		{
+			NewCounts.FindOrAdd(Stack->GetClass()) += Stack->GetQuantity();
+		});
+
+		TArray<TObjectKey<UClass>, TInlineAllocator<16>> ChangedClasses;
+		for (const TPair<TObjectKey<UClass>, int32>& Entry : NewCounts)
+		{
+			if (ItemCounts.FindRef(Entry.Key) != Entry.Value)
+			{
+				ChangedClasses.Add(Entry.Key);
+			}
+		}
+
+		for (const TPair<TObjectKey<UClass>, int32>& Entry : ItemCounts)
+		{
+			if (Entry.Value != 0 && !NewCounts.Contains(Entry.Key))
+			{
+				ChangedClasses.Add(Entry.Key);
+			}
+		}
+
+		ItemCounts = MoveTemp(NewCounts);
+
+		for (const TObjectKey<UClass>& ChangedClass : ChangedClasses)
+		{
+			bChanged |= RefreshRecipesUsing(ChangedClass.ResolveObjectPtr());
+		}
+	}
+
+	if (bChanged)
+	{
+		OnCraftableRecipesChanged.Broadcast();
+	}
+}
+
+bool UFNRCraftingComponent::RefreshRecipesUsing(const UClass* ItemClass)
+{
+	bool bChanged = false;
+
+	for (const int32 RecipeIndex : RecipeBook->GetRecipesUsing(ItemClass))
+	{
+		const bool bCraftable = HasIngredients(RecipeIndex);
+		if (CraftableRecipes[RecipeIndex] != bCraftable)
+		{
+			CraftableRecipes[RecipeIndex] = bCraftable;
+			bChanged = true;
+		}
+	}
+
+	return bChanged;
+}
+
+void UFNRCraftingComponent::RebuildFeasibility()
+{
+	ItemCounts.Reset();
+	CraftableRecipes.Init(false, IsValid(RecipeBook) ? RecipeBook->Recipes.Num() : 0);
+
+	if (!IsValid(RecipeBook) || !IsValid(Inventory))
+		return;
+
+	Inventory->ForEachItem([this](const UFNRInventoryItem* Item)
+	{
+		ItemCounts.FindOrAdd(Item->GetClass()) += Item->GetQuantity();
+	});
+
+	for (int32 RecipeIndex = 0; RecipeIndex < RecipeBook->Recipes.Num(); ++RecipeIndex)
+	{
+		CraftableRecipes[RecipeIndex] = HasIngredients(RecipeIndex);
+	}
+
+	OnCraftableRecipesChanged.Broadcast();
+}
+
+bool UFNRCraftingComponent::HasIngredients(const int32 RecipeIndex) const
+{
+	if (!IsValid(RecipeBook->Recipes[RecipeIndex]))
+		return false;
+
+	for (const FCraftingIngredient& Ingredient : RecipeBook->GetRequirements(RecipeIndex))
+	{
+		if (ItemCounts.FindRef(Ingredient.ItemClass.Get()) < Ingredient.Quantity)
+			return false;
+	}
+
+	return true;
+}
+
+bool UFNRCraftingComponent::HasRoomForResult(const UFNRCraftingRecipe* Recipe, TConstArrayView<FCraftingIngredient> Requirements) const
+{
+	const TConstArrayView<TObjectPtr<UFNRInventoryItem>> Items = Inventory->GetItemsView();
+
+	// Play the craft out on plain quantities: what each stack holds once the ingredients are gone, walking the stacks the way ConsumeItemsOfClass does
+	TArray<int32, TInlineAllocator<32>> Remaining;
+	Remaining.SetNumUninitialized(Items.Num());
+
+	float Weight = 0.f;
+	for (int32 Index = 0; Index < Items.Num(); ++Index)
+	{
+		Remaining[Index] = Items[Index] ? Items[Index]->GetQuantity() : 0;
+		Weight += Items[Index] ? Items[Index]->GetStackWeight() : 0.f;
+	}
+
+	for (const FCraftingIngredient& Ingredient : Requirements)
+	{
+		int32 ToConsume = Ingredient.Quantity;
+		for (int32 Index = Items.Num() - 1; Index >= 0 && ToConsume > 0; --Index)
+		{
+			if (!Items[Index] || Items[Index]->GetClass() != Ingredient.ItemClass)
+				continue;
+
+			const int32 Consumed = FMath::Min(ToConsume, Remaining[Index]);
+			Remaining[Index] -= Consumed;
+			ToConsume -= Consumed;
+			Weight -= Consumed * Items[Index]->Weight;
+		}
+	}
+
+	const UFNRInventoryItem* Result = GetDefault<UFNRInventoryItem>(Recipe->ResultClass);
+	int32 ResultToPlace = Recipe->ResultQuantity;
+	int32 UsedSlots = 0;
+
+	// Emptied stacks are removed and free their slot, stackable results top up what is left of their class first, same as TryAddItem
+	for (int32 Index = 0; Index < Items.Num(); ++Index)
+	{
+		if (Remaining[Index] <= 0)
+			continue;
+
+		++UsedSlots;
+
+		if (!Result->IsUnique() && Items[Index]->GetClass() == Recipe->ResultClass)
+		{
+			ResultToPlace -= FMath::Min(ResultToPlace, FMath::Max(Result->MaxStackSize - Remaining[Index], 0));
+		}
+	}
+
+	const int32 StacksNeeded = FMath::DivideAndRoundUp(ResultToPlace, Result->IsUnique() ? 1 : Result->MaxStackSize);
+	if (UsedSlots + StacksNeeded > Inventory->GetCapacity())
+		return false;
+
+	return Weight + Result->Weight * Recipe->ResultQuantity <= Inventory->GetWeightCapacity();
+}
+
+/*
+ * Helpers
+ */
+
+bool UFNRCraftingComponent::IsRecipeCraftable(const UFNRCraftingRecipe* Recipe) const
+{
+	if (!IsValid(RecipeBook))
+		return false;
+
+	const int32 RecipeIndex = RecipeBook->GetRecipeIndex(Recipe);
+	return CraftableRecipes.IsValidIndex(RecipeIndex) && CraftableRecipes[RecipeIndex];
+}
+
+void UFNRCraftingComponent::GetCraftableRecipes(TArray<UFNRCraftingRecipe*>& OutRecipes) const
+{
+	OutRecipes.Reset();
+
+	if (!IsValid(RecipeBook))
+		return;
+
+	for (TConstSetBitIterator<> It(CraftableRecipes); It; ++It)
+	{
+		OutRecipes.Add(RecipeBook->Recipes[It.GetIndex()]);
+	}
+}
@@ -0,0 +1,4 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Crafting/FNRCraftingRecipe.h"
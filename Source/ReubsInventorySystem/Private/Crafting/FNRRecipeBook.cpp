@@ -0,0 +1,94 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Crafting/FNRRecipeBook.h"
+
+#include "Crafting/FNRCraftingRecipe.h"
+
+TConstArrayView<int32> UFNRRecipeBook::GetRecipesUsing(const UClass* ItemClass) const
+{
+	if (!bIndexBuilt)
+	{
+		BuildIndex();
+	}
+
+	if (const TArray<int32>* RecipeIndices = RecipesByIngredient.Find(ItemClass))
+		return *RecipeIndices;
+
+	return {};
+}
+
+int32 UFNRRecipeBook::GetRecipeIndex(const UFNRCraftingRecipe* Recipe) const
+{
+	if (!bIndexBuilt)
+	{
+		BuildIndex();
+	}
+
+	if (const int32* RecipeIndex = RecipeIndices.Find(Recipe))
+		return *RecipeIndex;
+
+	return INDEX_NONE;
+}
+
+TConstArrayView<FCraftingIngredient> UFNRRecipeBook::GetRequirements(const int32 RecipeIndex) const
+{
+	if (!bIndexBuilt)
+	{
+		BuildIndex();
+	}
+
+	if (RecipeRequirements.IsValidIndex(RecipeIndex))
+		return RecipeRequirements[RecipeIndex];
+
+	return {};
+}
+
+#if WITH_EDITOR
+
+void UFNRRecipeBook::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	bIndexBuilt = false;
+}
+
+#endif
+
+void UFNRRecipeBook::BuildIndex() const
+{
+	RecipesByIngredient.Reset();
+	RecipeIndices.Reset();
+	RecipeRequirements.Reset();
+	RecipeRequirements.SetNum(Recipes.Num());
+
+	for (int32 RecipeIndex = 0; RecipeIndex < Recipes.Num(); ++RecipeIndex)
+	{
+		if (!IsValid(Recipes[RecipeIndex]))
+			continue;
+
+		RecipeIndices.Add(Recipes[RecipeIndex].Get(), RecipeIndex);
+
+		TArray<FCraftingIngredient>& Requirements = RecipeRequirements[RecipeIndex];
+
+		for (const FCraftingIngredient& Ingredient : Recipes[RecipeIndex]->Ingredients)
+		{
+			if (!Ingredient.ItemClass || Ingredient.Quantity <= 0)
+				continue;
+
+			RecipesByIngredient.FindOrAdd(Ingredient.ItemClass.Get()).AddUnique(RecipeIndex);
+
+			// A class listed twice has to be paid for twice
+			if (FCraftingIngredient* Existing = Requirements.FindByPredicate([&Ingredient](const FCraftingIngredient& Requirement) { return Requirement.ItemClass == Ingredient.ItemClass; }))
+			{
+				Existing->Quantity += Ingredient.Quantity;
+			}
+			else
+			{
+				Requirements.Add(Ingredient);
+			}
+		}
+	}
+
+	bIndexBuilt = true;
+}
@@ -0,0 +1,134 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Expiry/FNRExpirySubsystem.h"
+
+#include "Core/FNRInventoryComponent.h"
+#include "Core/FNRInventoryItem.h"
+#include "Engine/World.h"
+
+void UFNRExpirySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const uint64 TargetTick = GetTickAt(GetWorld()->GetTimeSeconds(), false);
+
+	TArray<FExpiryEntry> Expired;
+	while (CurrentTick <= TargetTick && NumScheduled > 0)
+	{
+		AdvanceTick(Expired);
+	}
+
+	if (Expired.Num() > 0)
+	{
+		DispatchExpired(Expired);
+	}
+}
+
+TStatId UFNRExpirySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFNRExpirySubsystem, STATGROUP_Tickables);
+}
+
+void UFNRExpirySubsystem::ScheduleExpiry(UFNRInventoryItem* Item)
+{
+	if (!IsValid(Item) || Item->ExpireTime <= 0.0)
+		return;
+
+	// The wheel stops turning while empty, catch up before placing anything relative to CurrentTick
+	if (NumScheduled == 0)
+	{
+		CurrentTick = FMath::Max(CurrentTick, GetTickAt(GetWorld()->GetTimeSeconds(), false));
+	}
+
+	FExpiryEntry Entry;
+	Entry.Item = Item;
+	Entry.ExpireTime = Item->ExpireTime;
+	Entry.ExpireTick = GetTickAt(Item->ExpireTime, true);
+
+	Insert(MoveTemp(Entry));
+}
+
+void UFNRExpirySubsystem::Insert(FExpiryEntry&& Entry)
+{
+	// Already due entries go in the next tick to process, too distant ones in the furthest slot of the last level
+	const uint64 Delta = Entry.ExpireTick > CurrentTick ? Entry.ExpireTick - CurrentTick : 0;
+	const uint64 PlacementDelta = FMath::Min(Delta, MaxTickDelta);
+	const uint64 PlacementTick = CurrentTick + PlacementDelta;
+
+	int32 Level = 0;
+	while (Level < NumLevels - 1 && PlacementDelta >= uint64(1) << (SlotBits * (Level + 1)))
+	{
+		++Level;
+	}
+
+	const int32 Slot = (PlacementTick >> (SlotBits * Level)) & (SlotsPerLevel - 1);
+	Wheel[Level][Slot].Add(MoveTemp(Entry));
+	++NumScheduled;
+}
+
+void UFNRExpirySubsystem::AdvanceTick(TArray<FExpiryEntry>& OutExpired)
+{
+	// Whenever a level wraps around, the next slot of the level above is spread over the levels below
+	for (int32 Level = 1; Level < NumLevels; ++Level)
+	{
+		const int32 LevelShift = SlotBits * Level;
+		if ((CurrentTick & ((uint64(1) << LevelShift) - 1)) != 0)
+			break;
+
+		TArray<FExpiryEntry> Cascaded = MoveTemp(Wheel[Level][(CurrentTick >> LevelShift) & (SlotsPerLevel - 1)]);
+		NumScheduled -= Cascaded.Num();
+
+		for (FExpiryEntry& Entry : Cascaded)
+		{
+			Insert(MoveTemp(Entry));
+		}
+	}
+
+	TArray<FExpiryEntry> Due = MoveTemp(Wheel[0][CurrentTick & (SlotsPerLevel - 1)]);
+	NumScheduled -= Due.Num();
+
+	const uint64 ProcessedTick = CurrentTick++;
+
+	for (FExpiryEntry& Entry : Due)
+	{
+		if (Entry.ExpireTick <= ProcessedTick)
+		{
+			OutExpired.Add(MoveTemp(Entry));
+		}
+		else
+		{
+			Insert(MoveTemp(Entry));
+		}
+	}
+}
+
+void UFNRExpirySubsystem::DispatchExpired(TConstArrayView<FExpiryEntry> Expired) const
+{
+	TMap<UFNRInventoryComponent*, TArray<UFNRInventoryItem*>> ExpiredByInventory;
+
+	for (const FExpiryEntry& Entry : Expired)
+	{
+		// Gone, moved or given another expiry since it was scheduled
+		UFNRInventoryItem* Item = Entry.Item.Get();
+		if (!Item || Item->ExpireTime != Entry.ExpireTime)
+			continue;
+
+		UFNRInventoryComponent* Inventory = Item->GetOwningInventory();
+		if (!IsValid(Inventory))
+			continue;
+
+		ExpiredByInventory.FindOrAdd(Inventory).Add(Item);
+	}
+
+	for (const TPair<UFNRInventoryComponent*, TArray<UFNRInventoryItem*>>& Pair : ExpiredByInventory)
+	{
+		Pair.Key->ExpireItems(Pair.Value);
+	}
+}
+
+uint64 UFNRExpirySubsystem::GetTickAt(const double Time, const bool bRoundUp) const
+{
+	const double Ticks = FMath::Max(Time, 0.0) / FMath::Max(TickInterval, KINDA_SMALL_NUMBER);
+	return static_cast<uint64>(bRoundUp ? FMath::CeilToDouble(Ticks) : FMath::FloorToDouble(Ticks));
+}
@@ -0,0 +1,151 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Loot/FNRLootTable.h"
+
+#include "Core/FNRInventoryComponent.h"
+#include "Core/FNRInventoryItem.h"
+
+void UFNRLootTable::FillInventory(UFNRInventoryComponent* Inventory, FRandomStream& Stream) const
+{
+	if (!IsValid(Inventory) || Inventory->GetOwnerRole() < ROLE_Authority)
+		return;
+
+	// ImportStacks doesn't check capacity, so the budget has to be measured against the real contents, stored ones included
+	Inventory->PrepareForAdd();
+
+	const int32 FreeSlots = Inventory->GetCapacity() - Inventory->GetItemsView().Num();
+	const float FreeWeight = Inventory->GetWeightCapacity() - Inventory->GetCurrentWeight();
+
+	TArray<FItemStackRecord> Stacks;
+	GenerateStacks(Stream, FreeSlots, FreeWeight, Stacks);
+
+	if (Stacks.Num() > 0)
+	{
+		Inventory->ImportStacks(Stacks);
+	}
+}
+
+void UFNRLootTable::GenerateStacks(FRandomStream& Stream, const int32 MaxStacks, const float MaxWeight, TArray<FItemStackRecord>& OutStacks) const
+{
+	if (!bAliasTableBuilt)
+	{
+		BuildAliasTable();
+	}
+
+	if (SlotEntries.Num() == 0 || MaxStacks <= 0)
+		return;
+
+	// Roll everything first, then lay the totals out in stacks, so a class rolled ten times still makes one stack
+	TArray<int32, TInlineAllocator<16>> Totals;
+	Totals.SetNumZeroed(ItemClasses.Num());
+
+	const int32 NumRolls = Stream.RandRange(MinRolls, FMath::Max(MinRolls, MaxRolls));
+	for (int32 Roll = 0; Roll < NumRolls; ++Roll)
+	{
+		const int32 EntryIndex = SampleEntry(Stream);
+		const FLootTableEntry& Entry = Entries[EntryIndex];
+		Totals[EntryClassIndices[EntryIndex]] += Stream.RandRange(Entry.MinQuantity, FMath::Max(Entry.MinQuantity, Entry.MaxQuantity));
+	}
+
+	const int32 FirstStack = OutStacks.Num();
+	float RemainingWeight = MaxWeight;
+
+	for (int32 ClassIndex = 0; ClassIndex < ItemClasses.Num(); ++ClassIndex)
+	{
+		int32 RemainingQuantity = Totals[ClassIndex];
+		if (RemainingQuantity <= 0)
+			continue;
+
+		const UFNRInventoryItem* ItemDefaults = ItemClasses[ClassIndex].GetDefaultObject();
+		const int32 StackSize = ItemDefaults->IsUnique() ? 1 : ItemDefaults->MaxStackSize;
+
+		if (ItemDefaults->Weight > 0.f)
+		{
+			RemainingQuantity = FMath::Min(RemainingQuantity, FMath::FloorToInt(RemainingWeight / ItemDefaults->Weight));
+		}
+
+		while (RemainingQuantity > 0 && OutStacks.Num() - FirstStack < MaxStacks)
+		{
+			FItemStackRecord& Stack = OutStacks.AddDefaulted_GetRef();
+			Stack.ItemClass = ItemClasses[ClassIndex];
+			Stack.Quantity = FMath::Min(RemainingQuantity, StackSize);
+			RemainingQuantity -= Stack.Quantity;
+			RemainingWeight -= Stack.Quantity * ItemDefaults->Weight;
+		}
+	}
+}
+
+#if WITH_EDITOR
+
+void UFNRLootTable::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	bAliasTableBuilt = false;
+}
+
+#endif
+
+int32 UFNRLootTable::SampleEntry(FRandomStream& Stream) const
+{
+	const int32 Slot = Stream.RandHelper(SlotEntries.Num());
+	return Stream.GetFraction() < SlotProbabilities[Slot] ? SlotEntries[Slot] : SlotAliases[Slot];
+}
+
+void UFNRLootTable::BuildAliasTable() const
+{
+	SlotProbabilities.Reset();
+	SlotEntries.Reset();
+	SlotAliases.Reset();
+	EntryClassIndices.Init(INDEX_NONE, Entries.Num());
+	ItemClasses.Reset();
+
+	float TotalWeight = 0.f;
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+	{
+		const FLootTableEntry& Entry = Entries[EntryIndex];
+		if (!Entry.ItemClass || Entry.Weight <= 0.f)
+			continue;
+
+		SlotEntries.Add(EntryIndex);
+		EntryClassIndices[EntryIndex] = ItemClasses.AddUnique(Entry.ItemClass);
+		TotalWeight += Entry.Weight;
+	}
+
+	const int32 NumSlots = SlotEntries.Num();
+	SlotProbabilities.SetNumUninitialized(NumSlots);
+	SlotAliases.SetNumUninitialized(NumSlots);
+
+	// Vose's alias method: scale every weight so the average is 1, then top up each slot below 1 with a slot above it
+	TArray<int32> Small;
+	TArray<int32> Large;
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		SlotProbabilities[Slot] = Entries[SlotEntries[Slot]].Weight * NumSlots / TotalWeight;
+		SlotAliases[Slot] = SlotEntries[Slot];
+		(SlotProbabilities[Slot] < 1.f ? Small : Large).Add(Slot);
+	}
+
+	while (Small.Num() > 0 && Large.Num() > 0)
+	{
+		const int32 SmallSlot = Small.Pop();
+		const int32 LargeSlot = Large.Pop();
+
+		SlotAliases[SmallSlot] = SlotEntries[LargeSlot];
+		SlotProbabilities[LargeSlot] += SlotProbabilities[SmallSlot] - 1.f;
+		(SlotProbabilities[LargeSlot] < 1.f ? Small : Large).Add(LargeSlot);
+	}
+
+	// Whatever is left is 1 give or take float error
+	for (const int32 Slot : Small)
+	{
+		SlotProbabilities[Slot] = 1.f;
+	}
+	for (const int32 Slot : Large)
+	{
+		SlotProbabilities[Slot] = 1.f;
+	}
+
+	bAliasTableBuilt = true;
+}
@@ -0,0 +1,178 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Storage/FNRStashComponent.h"
+
+#include "Core/FNRInventoryComponent.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+#include "Storage/FNRStashSubsystem.h"
+
+namespace
+{
+	void SerializeStacks(FArchive& BaseArchive, TArray<FItemStackRecord>& Stacks)
+	{
+		// Class references are written as paths so the data survives restarts
+		FObjectAndNameAsStringProxyArchive Ar(BaseArchive, true);
+
+		int32 NumStacks = Stacks.Num();
+		Ar << NumStacks;
+
+		if (Ar.IsLoading())
+		{
+			Stacks.SetNum(NumStacks);
+		}
+
+		for (FItemStackRecord& Stack : Stacks)
+		{
+			FItemStackRecord::StaticStruct()->SerializeItem(Ar, &Stack, nullptr);
+		}
+	}
+}
+
+UFNRStashComponent::UFNRStashComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+/*
+ * Behaviour
+ */
+
+void UFNRStashComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (GetOwnerRole() < ROLE_Authority || StashId.IsNone())
+		return;
+
+	Inventory = GetOwner()->FindComponentByClass<UFNRInventoryComponent>();
+	if (!IsValid(Inventory))
+		return;
+
+	ItemChangedHandle = Inventory->OnItemChanged.AddUObject(this, &ThisClass::OnItemChanged);
+	PreAddItemsHandle = Inventory->OnPreAddItems.AddUObject(this, &ThisClass::OnPreAddItems);
+	GetWorld()->GetSubsystem<UFNRStashSubsystem>()->RegisterStash(this);
+}
+
+void UFNRStashComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (IsValid(Inventory))
+	{
+		Inventory->OnItemChanged.Remove(ItemChangedHandle);
+		Inventory->OnPreAddItems.Remove(PreAddItemsHandle);
+
+		if (UFNRStashSubsystem* StashSubsystem = GetWorld()->GetSubsystem<UFNRStashSubsystem>())
+		{
+			StashSubsystem->UnregisterStash(this);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UFNRStashComponent::OpenStash(AController* User)
+{
+	if (GetOwnerRole() < ROLE_Authority || !IsValid(Inventory))
+		return;
+
+	if (IsValid(User))
+	{
+		Users.Add(User);
+	}
+	else
+	{
+		++ServerOpenCount;
+	}
+
+	GetWorld()->GetSubsystem<UFNRStashSubsystem>()->MaterializeStash(this);
+}
+
+void UFNRStashComponent::CloseStash(AController* User)
+{
+	if (IsValid(User))
+	{
+		Users.RemoveSingleSwap(User);
+	}
+	else if (ServerOpenCount > 0)
+	{
+		--ServerOpenCount;
+	}
+}
+
+bool UFNRStashComponent::IsOpen() const
+{
+	PruneUsers();
+
+	return ServerOpenCount > 0 || Users.Num() > 0;
+}
+
+bool UFNRStashComponent::IsOpenedBy(const AController* User) const
+{
+	PruneUsers();
+
+	return IsValid(User) && Users.Contains(User);
+}
+
+void UFNRStashComponent::PruneUsers() const
+{
+	// Players who disconnected or died never close the stash themselves
+	Users.RemoveAllSwap([](const TWeakObjectPtr<AController>& Opener)
+	{
+		return !Opener.IsValid() || !IsValid(Opener->GetPawn());
+	});
+}
+
+void UFNRStashComponent::LoadContents(const TArray<uint8>& Data)
+{
+	TArray<FItemStackRecord> Stacks;
+	if (Data.Num() > 0)
+	{
+		FMemoryReader Reader(Data, true);
+		SerializeStacks(Reader, Stacks);
+	}
+
+	TGuardValue<bool> ApplyingGuard(bApplyingStoredContents, true);
+	Inventory->ImportStacks(Stacks);
+	bMaterialized = true;
+}
+
+void UFNRStashComponent::SaveContents(TArray<uint8>& OutData) const
+{
+	TArray<FItemStackRecord> Stacks;
+	Inventory->ExportStacks(Stacks);
+
+	OutData.Reset();
+	FMemoryWriter Writer(OutData, true);
+	SerializeStacks(Writer, Stacks);
+}
+
+void UFNRStashComponent::UnloadContents(TArray<uint8>& OutData)
+{
+	SaveContents(OutData);
+
+	TGuardValue<bool> ApplyingGuard(bApplyingStoredContents, true);
+	Inventory->ClearItems();
+	bMaterialized = false;
+}
+
+void UFNRStashComponent::OnItemChanged(UFNRInventoryItem* Item)
+{
+	// Edits only count once the stored contents are live, anything else would be saved over them
+	if (bMaterialized && !bApplyingStoredContents)
+	{
+		GetWorld()->GetSubsystem<UFNRStashSubsystem>()->MarkStashDirty(this);
+	}
+}
+
+void UFNRStashComponent::OnPreAddItems()
+{
+	// Items added to a closed stash (loot fills, transfers) land on top of the stored contents instead of next to an empty inventory
+	if (!bMaterialized && !bApplyingStoredContents)
+	{
+		GetWorld()->GetSubsystem<UFNRStashSubsystem>()->MaterializeStash(this);
+	}
+}
@@ -0,0 +1,184 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+
+#include "Storage/FNRStashSubsystem.h"
+
+#include "Async/Async.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Storage/FNRStashComponent.h"
+#include "TimerManager.h"
+
+void UFNRStashSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (InWorld.GetNetMode() == NM_Client)
+		return;
+
+	InWorld.GetTimerManager().SetTimer(FlushTimerHandle, FTimerDelegate::CreateUObject(this, &ThisClass::FlushDirty, MaxStashesPerFlush), FlushInterval, true);
+}
+
+void UFNRStashSubsystem::Deinitialize()
+{
+	FlushAll();
+
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+
+	Super::Deinitialize();
+}
+
+void UFNRStashSubsystem::RegisterStash(UFNRStashComponent* Stash)
+{
+	// Only remember who to load into, the data itself is read from disk on first open
+	Stashes.FindOrAdd(Stash->GetStashId()).Component = Stash;
+}
+
+void UFNRStashSubsystem::UnregisterStash(UFNRStashComponent* Stash)
+{
+	FStashEntry* Entry = Stashes.Find(Stash->GetStashId());
+	if (!Entry || Entry->Component != Stash)
+		return;
+
+	if (Stash->IsMaterialized())
+	{
+		Stash->UnloadContents(Entry->Data);
+		MaterializedStashes.Remove(Stash->GetStashId());
+	}
+
+	Entry->Component = nullptr;
+}
+
+void UFNRStashSubsystem::MaterializeStash(UFNRStashComponent* Stash)
+{
+	const FName StashId = Stash->GetStashId();
+
+	// Move to the back of the recency list
+	MaterializedStashes.Remove(StashId);
+	MaterializedStashes.Add(StashId);
+
+	if (!Stash->IsMaterialized())
+	{
+		FStashEntry& Entry = FindOrLoadEntry(StashId);
+		Entry.Component = Stash;
+		Stash->LoadContents(Entry.Data);
+
+		// The live items are the source of truth from now on
+		Entry.Data.Empty();
+	}
+
+	EnforceMaterializedCap();
+}
+
+void UFNRStashSubsystem::MarkStashDirty(const UFNRStashComponent* Stash)
+{
+	if (FStashEntry* Entry = Stashes.Find(Stash->GetStashId()))
+	{
+		Entry->bDirty = true;
+	}
+}
+
+void UFNRStashSubsystem::FlushAll()
+{
+	FlushDirty(MAX_int32);
+}
+
+UFNRStashSubsystem::FStashEntry& UFNRStashSubsystem::FindOrLoadEntry(const FName StashId)
+{
+	FStashEntry& Entry = Stashes.FindOrAdd(StashId);
+
+	if (!Entry.bLoaded)
+	{
+		// A missing file just means an empty stash
+		FFileHelper::LoadFileToArray(Entry.Data, *GetStashPath(StashId), FILEREAD_Silent);
+		Entry.bLoaded = true;
+	}
+
+	return Entry;
+}
+
+void UFNRStashSubsystem::EnforceMaterializedCap()
+{
+	// The most recent stash is always kept, it was just materialized for someone about to use it
+	for (int32 Index = 0; Index < MaterializedStashes.Num() - 1 && MaterializedStashes.Num() > MaxMaterializedStashes; )
+	{
+		FStashEntry* Entry = Stashes.Find(MaterializedStashes[Index]);
+		UFNRStashComponent* Stash = Entry ? Entry->Component.Get() : nullptr;
+
+		if (IsValid(Stash) && Stash->IsOpen())
+		{
+			++Index;
+			continue;
+		}
+
+		if (IsValid(Stash))
+		{
+			Stash->UnloadContents(Entry->Data);
+		}
+
+		MaterializedStashes.RemoveAt(Index);
+	}
+}
+
+void UFNRStashSubsystem::FlushDirty(const int32 MaxStashes)
+{
+	if (PendingWrite.IsValid() && !PendingWrite.IsReady())
+	{
+		if (MaxStashes != MAX_int32)
+			return;
+
+		PendingWrite.Wait();
+	}
+
+	// Serialize on the game thread since that touches the live items, write on a worker
+	TArray<TPair<FString, TArray<uint8>>> Batch;
+
+	for (TPair<FName, FStashEntry>& Pair : Stashes)
+	{
+		if (Batch.Num() >= MaxStashes)
+			break;
+
+		FStashEntry& Entry = Pair.Value;
+		if (!Entry.bDirty)
+			continue;
+
+		Entry.bDirty = false;
+
+		// Never read from disk means Data is empty rather than the stored contents, writing it would wipe the file
+		UFNRStashComponent* Stash = Entry.Component.Get();
+		const bool bMaterialized = IsValid(Stash) && Stash->IsMaterialized();
+		if (!bMaterialized && !Entry.bLoaded)
+			continue;
+
+		TPair<FString, TArray<uint8>>& Write = Batch.AddDefaulted_GetRef();
+		Write.Key = GetStashPath(Pair.Key);
+
+		if (bMaterialized)
+		{
+			Stash->SaveContents(Write.Value);
+		}
+		else
+		{
+			Write.Value = Entry.Data;
+		}
+	}
+
+	if (Batch.IsEmpty())
+		return;
+
+	PendingWrite = Async(EAsyncExecution::ThreadPool, [Batch = MoveTemp(Batch)]()
+	{
+		for (const TPair<FString, TArray<uint8>>& Write : Batch)
+		{
+			FFileHelper::SaveArrayToFile(Write.Value, *Write.Key);
+		}
+	});
+}
+
+FString UFNRStashSubsystem::GetStashPath(const FName StashId)
+{
+	return FPaths::ProjectSavedDir() / TEXT("Stashes") / StashId.ToString() + TEXT(".stash");
+}
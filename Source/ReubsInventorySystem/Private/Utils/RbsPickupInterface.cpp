@@ -5,3 +5,7 @@
 
 
 // Add default functionality here for any IRbsPickupInterface functions that are not pure virtual.
+
+void IRbsPickupInterface::SetPickupStack_Implementation(const FItemStackRecord& Stack)
+{
+}
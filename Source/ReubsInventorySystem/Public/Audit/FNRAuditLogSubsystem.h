@@ -0,0 +1,77 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Utils/RbsTypes.h"
+#include "FNRAuditLogSubsystem.generated.h"
+
+class UFNRInventoryComponent;
+class UFNRInventoryItem;
+
+/**
+ * Append-only log of every server-side inventory mutation. Entries go into a fixed size ring buffer on the game thread
+ * and are formatted and appended to Saved/Audit on a worker, so recording one is a few stores.
+ */
+UCLASS(Config = Game)
+class REUBSINVENTORYSYSTEM_API UFNRAuditLogSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+////////////////////////////////////////////// Variables ///////////////////////////////////////////////////////////////
+	
+/*
+ * info
+ */
+
+protected:
+	UPROPERTY(Config)
+	bool bEnabled = true;
+
+	/**Entries kept between flushes. When full and the previous write is still running, the oldest entries are overwritten*/
+	UPROPERTY(Config)
+	int32 BufferCapacity = 4096;
+
+	UPROPERTY(Config)
+	float FlushInterval = 5.f;
+
+private:
+	struct FAuditEntry
+	{
+		FDateTime Time;
+		int64 ItemId = 0;
+		//Interned by UFNRInventoryComponent::GetAuditId so recording never builds a string
+		FName Inventory;
+		FName ItemClass;
+		int32 Quantity = 0;
+		EInventoryAuditAction Action = EInventoryAuditAction::IAA_Add;
+	};
+
+	TArray<FAuditEntry> Buffer;
+
+	//Oldest entry once Buffer has wrapped around
+	int32 Head = 0;
+
+	int64 OverwrittenEntries = 0;
+
+	FString LogPath;
+	FTimerHandle FlushTimerHandle;
+	TFuture<void> PendingWrite;
+
+////////////////////////////////////////////// Functions ///////////////////////////////////////////////////////////////	
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	void Record(const UFNRInventoryComponent* Inventory, const EInventoryAuditAction Action, const UFNRInventoryItem* Item, const int32 Quantity);
+
+	UFUNCTION(BlueprintCallable, Category = "Audit")
+	void Flush();
+
+	/**Entries lost because the buffer filled up while a write was still in flight*/
+	FORCEINLINE int64 GetOverwrittenEntries() const { return OverwrittenEntries; }
+};
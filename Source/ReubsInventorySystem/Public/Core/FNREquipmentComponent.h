@@ -0,0 +1,131 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Utils/RbsTypes.h"
+#include "FNREquipmentComponent.generated.h"
+
+class UFNRInventoryComponent;
+class UFNRInventoryItem;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnEquipmentUpdated);
+
+/**Equips items from the owner's UFNRInventoryComponent into named slots and keeps their stat modifiers aggregated*/
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class REUBSINVENTORYSYSTEM_API UFNREquipmentComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFNREquipmentComponent();
+
+////////////////////////////////////////////// Variables ///////////////////////////////////////////////////////////////
+	
+/*
+ * info
+ */
+
+protected:
+	/**Slots this component accepts, matched against UFNRInventoryItem::EquipmentSlot*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Equipment")
+	TArray<FName> Slots;
+
+	//Only replicated to the owner, everyone else gets EquippedSummary
+	UPROPERTY(ReplicatedUsing = OnRep_EquippedItems, VisibleAnywhere, Category = "Equipment")
+	TArray<FEquippedItem> EquippedItems;
+
+	UPROPERTY(ReplicatedUsing = OnRep_EquippedSummary)
+	TArray<FEquippedItemSummary> EquippedSummary;
+
+	UPROPERTY()
+	TObjectPtr<UFNRInventoryComponent> Inventory;
+
+private:
+	FDelegateHandle ItemChangedHandle;
+
+protected:
+
+/*
+ * Behaviour
+ */
+
+	UPROPERTY(BlueprintAssignable, Category = "Equipment")
+	FOnEquipmentUpdated OnEquipmentUpdated;
+
+/*
+ * Stats
+ */
+
+private:
+	//Modifiers of every equipped item summed per stat. Only rebuilt after the equipped items change
+	mutable TMap<FName, FItemStatModifier> CachedStats;
+	mutable bool bStatsDirty = true;
+
+////////////////////////////////////////////// Functions ///////////////////////////////////////////////////////////////	
+
+/*
+ * Replication
+ */
+
+public:
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+private:
+	UFUNCTION()
+	void OnRep_EquippedItems();
+
+	UFUNCTION()
+	void OnRep_EquippedSummary();
+
+/*
+ * Behaviour
+ */
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	/**Equip an item from our inventory into its EquipmentSlot, replacing whatever was there. Clients ask the server and return false*/
+	UFUNCTION(BlueprintCallable, Category = "Equipment")
+	bool EquipItem(UFNRInventoryItem* Item);
+
+	UFUNCTION(Server, Reliable)
+	void ServerEquipItem(const int64 ItemId);
+
+	UFUNCTION(BlueprintCallable, Category = "Equipment")
+	bool UnequipSlot(const FName Slot);
+
+	UFUNCTION(Server, Reliable)
+	void ServerUnequipSlot(const FName Slot);
+
+private:
+	//Drops equipped items that left the inventory
+	void OnInventoryItemChanged(UFNRInventoryItem* Item);
+
+	void OnEquipmentChanged();
+	void RebuildStatCache() const;
+
+/*
+ * Helpers
+ */
+
+public:
+	UFUNCTION(BlueprintPure, Category = "Equipment")
+	UFNRInventoryItem* GetEquippedItem(const FName Slot) const;
+
+	/**Class of the item in Slot. Unlike GetEquippedItem this also works on non-owners*/
+	UFUNCTION(BlueprintPure, Category = "Equipment")
+	TSubclassOf<UFNRInventoryItem> GetEquippedItemClass(const FName Slot) const;
+
+	UFUNCTION(BlueprintPure, Category = "Equipment")
+	bool IsEquipped(const UFNRInventoryItem* Item) const;
+
+	/**Return (BaseValue + summed additives) * multiplied multipliers of the equipped items. Owner and server only*/
+	UFUNCTION(BlueprintPure, Category = "Equipment")
+	float GetStatValue(const FName Stat, const float BaseValue = 0.f) const;
+
+	FORCEINLINE const TArray<FEquippedItem>& GetEquippedItems() const { return EquippedItems; }
+};
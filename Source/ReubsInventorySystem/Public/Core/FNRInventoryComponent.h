@@ -9,6 +9,7 @@
 #include "FNRInventoryComponent.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnInventoryUpdated);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnInventoryItemChanged, UFNRInventoryItem* /*Item*/);
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class REUBSINVENTORYSYSTEM_API UFNRInventoryComponent : public UActorComponent
@@ -36,6 +37,10 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Inventory", meta = (ClampMin=0, ClampMax=500))
 	int32 Capacity;
 
+	/**How close the owner's pawn has to be to a container that isn't a stash to transfer items with it*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Inventory", meta = (ClampMin=0))
+	float MaxContainerAccessDistance = 300.f;
+
 /*
  * Behaviour
  */
@@ -45,7 +50,53 @@ protected:
 	
 	UPROPERTY(BlueprintAssignable, Category = "Inventory")
 	FOnInventoryUpdated OnInventoryUpdated;
-	
+
+public:
+	/**Fired with the stack that was added, removed or changed quantity. Clients receiving a new item list get nullptr instead, since they can't tell which stacks changed*/
+	FOnInventoryItemChanged OnItemChanged;
+
+	/**Fired on the server right before items are added, so listeners can bring the inventory up to date first*/
+	FSimpleMulticastDelegate OnPreAddItems;
+
+protected:
+/*
+ * Sorting
+ */
+
+	/**Order the server keeps Items in. New stacks are inserted in place, so the array is only fully sorted when the mode changes*/
+	UPROPERTY(Replicated, EditAnywhere, BlueprintReadOnly, Category = "Inventory|Sorting")
+	EInventorySortMode SortMode = EInventorySortMode::ISM_None;
+
+private:
+	//Items grouped by UFNRInventoryItem::CategoryName, each bucket in Items order. Kept up to date on add/remove on the server, rebuilt on replication on clients
+	TMap<FName, TArray<TObjectPtr<UFNRInventoryItem>>> CategoryBuckets;
+
+/*
+ * Prediction
+ */
+
+protected:
+	/**When enabled the owning client applies UseItem/DropItem to a local shadow of Items straight away and reconciles once the server acknowledges the prediction*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Inventory|Prediction")
+	bool bUsePrediction = false;
+
+private:
+	//Highest prediction key the server has processed for the owning client
+	UPROPERTY(ReplicatedUsing = OnRep_LastAckedPredictionKey)
+	int32 LastAckedPredictionKey = 0;
+
+	//Client only
+	int32 NextPredictionKey = 0;
+	int32 ActivePredictionKey = 0;
+	TArray<FItemPrediction> PendingPredictions;
+
+	//Client only. Items whose predicted quantity is above zero, in Items order
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UFNRInventoryItem>> PredictedItems;
+
+	//Hash of the last predicted state broadcast, used to skip OnInventoryUpdated when the server just confirmed what we showed
+	uint32 PredictedStateHash = 0;
+
 
 /*
  * Replication
@@ -55,6 +106,12 @@ private:
 	UPROPERTY()
 	int32 ReplicatedItemsKey = 0;	
 
+	//Every item in Items by UFNRInventoryItem::ItemId
+	TMap<int64, TObjectPtr<UFNRInventoryItem>> ItemsById;
+
+	//GetAuditId result once it can't change anymore
+	mutable FName CachedAuditId;
+
 ////////////////////////////////////////////// Functions ///////////////////////////////////////////////////////////////	
 
 /*
@@ -68,14 +125,103 @@ public:
 private:
 	UFUNCTION()
 	void OnReplicated_Items();
+
+	UFUNCTION()
+	void OnRep_LastAckedPredictionKey();
+	
+/*
+ * Prediction
+ */
+
+public:
+	/**True on an owning client with bUsePrediction enabled*/
+	UFUNCTION(BlueprintPure, Category = "Inventory|Prediction")
+	bool IsPredicting() const;
+
+	/**Items as the owning client should display them. Same as GetItems() when not predicting*/
+	UFUNCTION(BlueprintPure, Category = "Inventory|Prediction")
+	TArray<UFNRInventoryItem*> GetPredictedItems() const;
+
+	TConstArrayView<TObjectPtr<UFNRInventoryItem>> GetPredictedItemsView() const;
+
+private:
+	int32 PredictConsume(UFNRInventoryItem* Item, const int32 Quantity);
+	void AckPrediction(const int32 PredictionKey);
+	void ReconcilePredictions();
+
+	//Broadcasts OnInventoryUpdated, or reconciles first when predicting so a confirmed prediction doesn't fire twice
+	void NotifyInventoryUpdated();
 	
+/*
+ * Sorting
+ */
+
+public:
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Sorting")
+	void SetSortMode(const EInventorySortMode NewSortMode);
+
+	UFUNCTION(Server, Reliable)
+	void ServerSetSortMode(const EInventorySortMode NewSortMode);
+
+	UFUNCTION(BlueprintPure, Category = "Inventory|Sorting")
+	FORCEINLINE EInventorySortMode GetSortMode() const { return SortMode; }
+
+	/**Return the items whose CategoryName matches, in inventory order, without scanning the whole inventory*/
+	UFUNCTION(BlueprintPure, Category = "Inventory|Sorting")
+	TArray<UFNRInventoryItem*> GetItemsInCategory(const FName CategoryName) const;
+
+	/**Same as GetItemsInCategory but fills OutItems, reusing its allocation*/
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Sorting")
+	void GetItemsInCategoryInto(const FName CategoryName, UPARAM(ref) TArray<UFNRInventoryItem*>& OutItems) const;
+
+	TConstArrayView<TObjectPtr<UFNRInventoryItem>> GetCategoryView(const FName CategoryName) const;
+
+	/**Return every category that currently has at least one item*/
+	UFUNCTION(BlueprintPure, Category = "Inventory|Sorting")
+	TArray<FName> GetCategories() const;
+
+	/**Return true if A goes before B. Weight and value sort heaviest/most valuable first, category and name alphabetically*/
+	static bool SortPredicate(const UFNRInventoryItem* A, const UFNRInventoryItem* B, const EInventorySortMode Mode);
+
+private:
+	void InsertSorted(UFNRInventoryItem* Item);
+	void RemoveFromCategoryBucket(UFNRInventoryItem* Item);
+	void RebuildCategoryBuckets();
+
 /*
  * Behaviour
  */
 
 private:
 	
-	UFNRInventoryItem* AddItem(UFNRInventoryItem* Item);
+	//Template only provides the class, the new stack gets InstanceState and ExpireTime
+	UFNRInventoryItem* AddItem(const UFNRInventoryItem* Template, const int32 StackQuantity, const FItemInstanceState& InstanceState, const double ExpireTime);
+
+	void RecordAudit(const EInventoryAuditAction Action, const UFNRInventoryItem* Item, const int32 Quantity) const;
+
+	//ConsumeItem, logged as Action so drops and transfers get a single audit entry
+	int32 ConsumeItem_Internal(UFNRInventoryItem* Item, const int32 Quantity, const EInventoryAuditAction Action);
+
+	void ScheduleExpiry(UFNRInventoryItem* Item) const;
+
+	//ExpireTime a stack created from Template gets: the template's own if it has one, a fresh Lifetime otherwise
+	double GetNewStackExpireTime(const UFNRInventoryItem* Template) const;
+
+	//Quantity units of Item as a record, Quantity may be less than the whole stack
+	FItemStackRecord MakeStackRecord(const UFNRInventoryItem* Item, const int32 Quantity) const;
+
+	//Stack.ExpiresAtUtc as world time, 0 if the record doesn't expire
+	double GetRecordExpireTime(const FItemStackRecord& Stack) const;
+
+	//Creates a stack and puts it in Items without notifying anyone, callers batch the notifications
+	UFNRInventoryItem* CreateStack(TSubclassOf<UFNRInventoryItem> ItemClass, const int32 StackQuantity, const FItemInstanceState& InstanceState, const int64 ItemId = 0);
+
+	//TAddPolicy decides at compile time whether existing stacks are merged into and how big new stacks are, see FStackableAddPolicy/FUniqueAddPolicy
+	template <typename TAddPolicy>
+	FItemAddResult TryAddItem_Impl(const UFNRInventoryItem* Template, const int32 AddAmount, const FItemInstanceState& InstanceState, const double ExpireTime);
+
+	//Same as the public overload, with the instance state and expiry given separately so a class default object can stand in for a recorded stack
+	FItemAddResult TryAddItem_Internal(const UFNRInventoryItem* Template, const int32 Quantity, const FItemInstanceState& InstanceState, const double ExpireTime);
 
 public:	
 	
@@ -87,23 +233,59 @@ public:
 
 	FItemAddResult TryAddItem_Internal(UFNRInventoryItem* Item);
 
+	/**Add Quantity units shaped like Template. Template is only read from, so a class default object can be passed*/
+	FItemAddResult TryAddItem_Internal(const UFNRInventoryItem* Template, const int32 Quantity);
+
+	/**Add a stack recorded by ExportStacks or a dropped pickup, keeping its instance state and expiry. Follows the usual capacity, weight and stacking rules*/
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	FItemAddResult TryAddStack(const FItemStackRecord& Stack);
+
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 	bool RemoveItem(UFNRInventoryItem* Item);
 	
 	int32 ConsumeItem(UFNRInventoryItem* Item);
 	int32 ConsumeItem(UFNRInventoryItem* Item, const int32 Quantity);
 
+	/**Append the stacks as they are, bypassing capacity, weight and stacking rules. One replication update for the whole batch*/
+	void ImportStacks(TConstArrayView<FItemStackRecord> Stacks);
+
+	void ExportStacks(TArray<FItemStackRecord>& OutStacks) const;
+
+	/**Server only. Fires OnPreAddItems so listeners such as a closed stash load what's missing. Every add does this itself, call it first when sizing a batch against the free space*/
+	void PrepareForAdd();
+
+	/**Remove every item at once*/
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	void ClearItems();
+
+	/**Called by UFNRExpirySubsystem with every stack of this inventory that expired on the same tick*/
+	void ExpireItems(TConstArrayView<UFNRInventoryItem*> ExpiredItems);
+
+	/**Consume Quantity units of ItemClass across as many stacks as needed. Returns how many were actually consumed*/
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	int32 ConsumeItemsOfClass(TSubclassOf<UFNRInventoryItem> ItemClass, const int32 Quantity);
+
 	UFUNCTION(BlueprintCallable, Category = "Items")
 	void UseItem(UFNRInventoryItem* Item);
 
 	UFUNCTION(Server, Reliable)
-	void ServerUseItem(UFNRInventoryItem* Item);
+	void ServerUseItem(const int64 ItemId, const int32 PredictionKey);
 
 	UFUNCTION(BlueprintCallable, Category = "Items")
 	void DropItem(UFNRInventoryItem* Item, const int32 Quantity);
 
 	UFUNCTION(Server, Reliable)
-	void ServerDropItem(UFNRInventoryItem* Item, const int32 Quantity);
+	void ServerDropItem(const int64 ItemId, const int32 Quantity, const int32 PredictionKey);
+
+	/**Move Quantity units of stack ItemId from From to To, one of which must be this inventory. Whatever To can't take stays in From. The moved units go through To's usual add rules, so they may merge into existing stacks there and never keep ItemId. Clients ask the server*/
+	UFUNCTION(BlueprintCallable, Category = "Items")
+	void TransferItem(UFNRInventoryComponent* From, UFNRInventoryComponent* To, const int64 ItemId, const int32 Quantity);
+
+	/**Server side check for client requested transfers. Stashes must be opened by our controller, other players' inventories are never accessible, anything else must be within MaxContainerAccessDistance*/
+	bool CanAccessContainer(const UFNRInventoryComponent* Container) const;
+
+	UFUNCTION(Server, Reliable)
+	void ServerTransferItem(UFNRInventoryComponent* From, UFNRInventoryComponent* To, const int64 ItemId, const int32 Quantity);
 
 protected:
 
@@ -121,8 +303,57 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	FORCEINLINE int32 GetCapacity() const { return Capacity; }
 
+	/**Copies the item list, prefer GetItemsInto from Blueprint and GetItemsView/ForEachItem from C++*/
 	UFUNCTION(BlueprintPure, Category = "Inventory")
-	FORCEINLINE TArray<UFNRInventoryItem*> GetItems() const { return Items; }
+	TArray<UFNRInventoryItem*> GetItems() const;
+
+	/**Fill OutItems with every item, reusing its allocation*/
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	void GetItemsInto(UPARAM(ref) TArray<UFNRInventoryItem*>& OutItems) const;
+
+	FORCEINLINE TConstArrayView<TObjectPtr<UFNRInventoryItem>> GetItemsView() const { return Items; }
+
+	/**Call Callback(UFNRInventoryItem*) for every item*/
+	template <typename FuncType>
+	void ForEachItem(FuncType&& Callback) const
+	{
+		for (UFNRInventoryItem* Item : Items)
+		{
+			// Clients can briefly hold entries whose subobject hasn't resolved yet
+			if (Item)
+			{
+				Callback(Item);
+			}
+		}
+	}
+
+	/**Call Callback(UFNRInventoryItem*) for every item whose class is exactly ItemClass*/
+	template <typename FuncType>
+	void ForEachItemOfClass(const UClass* ItemClass, FuncType&& Callback) const
+	{
+		ForEachItem([ItemClass, &Callback](UFNRInventoryItem* Item)
+		{
+			if (Item->GetClass() == ItemClass)
+			{
+				Callback(Item);
+			}
+		});
+	}
+
+	/**Return the first item Predicate(const UFNRInventoryItem*) returns true for*/
+	template <typename PredicateType>
+	UFNRInventoryItem* FindItemByPredicate(PredicateType&& Predicate) const
+	{
+		for (UFNRInventoryItem* Item : Items)
+		{
+			if (Item && Predicate(Item))
+			{
+				return Item;
+			}
+		}
+
+		return nullptr;
+	}
 
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	float GetCurrentWeight() const;
@@ -137,6 +368,22 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	bool HasItem(TSubclassOf <UFNRInventoryItem> ItemClass, const int32 Quantity = 1) const;
 
+	/**Return the total quantity of ItemClass across all its stacks*/
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	int32 GetItemCount(TSubclassOf<UFNRInventoryItem> ItemClass) const;
+
+	/**Return true if this exact item instance is in this inventory. Unlike FindItem this doesn't accept another stack of the same class*/
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	bool OwnsItem(const UFNRInventoryItem* Item) const;
+
+	/**Stable name for this inventory in the audit log: the stash id for stashes, the player's unique net id for player inventories.
+	 * Resolved once and cached, pawns and player states keep looking until their player is known*/
+	FName GetAuditId() const;
+
+	/**O(1) lookup of a stack by its ItemId, nullptr if it isn't in this inventory*/
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+	UFNRInventoryItem* FindItemById(const int64 ItemId) const;
+
 	/**Return the first item with the same class as a given Item*/
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	UFNRInventoryItem* FindItem(UFNRInventoryItem* Item) const;
@@ -152,5 +399,9 @@ public:
 	/**Get all inventory items that are a child of ItemClass. Useful for grabbing all weapons, all food, etc*/
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 	TArray<UFNRInventoryItem*> FindItemsByClass(TSubclassOf<UFNRInventoryItem> ItemClass) const;
+
+	/**Same as FindItemsByClass but fills OutItems, reusing its allocation*/
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+	void FindItemsByClassInto(TSubclassOf<UFNRInventoryItem> ItemClass, UPARAM(ref) TArray<UFNRInventoryItem*>& OutItems) const;
 	
 };
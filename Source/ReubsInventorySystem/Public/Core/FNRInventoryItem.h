@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "Utils/RbsTypes.h"
 #include "FNRInventoryItem.generated.h"
 
 class URbsItemTooltip;
@@ -29,6 +30,17 @@ public:
 	UPROPERTY()
 	int32 RepKey = 0;
 
+	//Server only. Identifies the item in the actor channel's replication keys, unlike a hash of ItemId it never collides
+	int32 SubobjectKey = 0;
+
+/*
+ * Identity
+ */
+
+	//Assigned by the server when the stack is created, never reused. Use it instead of the object to refer to a stack over the network or in save data
+	UPROPERTY(Replicated, BlueprintReadOnly, Category = "Item")
+	int64 ItemId = 0;
+
 /*
  * Properties
  */
@@ -44,6 +56,10 @@ public:
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
 	FText Category;
+
+	//Used for sorting and category filters, Category is only the displayed text
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item")
+	FName CategoryName;
 	
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (MultiLine = true))
 	FText Description;
@@ -57,6 +73,9 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (ClampMin = 0.0))
 	float Weight = 1.f;
 
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (ClampMin = 0))
+	int32 Value = 0;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
 	bool bStackable = true;
 
@@ -66,12 +85,33 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
 	TSubclassOf<URbsItemTooltip> ItemTooltip;
 
+	//Equipment slot this item can go into, None if it can't be equipped
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item|Equipment")
+	FName EquipmentSlot;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item|Equipment")
+	TArray<FItemStatModifier> StatModifiers;
+
+	//Seconds a new stack lasts before it expires, 0 if it never does
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Item|Expiry", meta = (ClampMin = 0.0))
+	float Lifetime = 0.f;
+
+	//Server world time this stack expires at, 0 if it never does. Merged stacks keep the earliest one
+	UPROPERTY(ReplicatedUsing = OnRep_ExpireTime, BlueprintReadOnly, Category = "Item|Expiry")
+	double ExpireTime = 0.0;
+
 	UPROPERTY(ReplicatedUsing = OnRep_Quantity, EditAnywhere, Category = "Item", meta = (UIMin = 1, EditCondition = bStackable))
 	int32 Quantity = 1;
+
+	UPROPERTY(ReplicatedUsing = OnRep_InstanceState, EditAnywhere, BlueprintReadOnly, Category = "Item", meta = (EditCondition = "!bStackable"))
+	FItemInstanceState InstanceState;
 	
 	UPROPERTY()
 	TObjectPtr<UFNRInventoryComponent> OwningInventory;
 
+	//Client only. Sum of the unacknowledged predictions on this stack, rebuilt by the owning inventory on every reconcile
+	int32 PredictedQuantityDelta = 0;
+
 ///////////////////////////////////////////////////// Functions ////////////////////////////////////////////////////////
 
 
@@ -91,10 +131,22 @@ protected:
 		
 	UFUNCTION()
 	void OnRep_Quantity();
+
+	UFUNCTION()
+	void OnRep_InstanceState();
+
+	UFUNCTION()
+	void OnRep_ExpireTime();
 	
 public:
 	void MarkDirtyForReplication();
 
+	/**Server only. Unique across server restarts: the process start time goes in the high bits*/
+	static int64 GenerateItemId();
+
+	/**Server only. Never 0, which the owning inventory uses for its item list*/
+	static int32 GenerateSubobjectKey();
+
 /*
  * Behaviour
  */
@@ -110,8 +162,19 @@ public:
 	UFUNCTION(BlueprintNativeEvent)
 	void AddedToInventory(UFNRInventoryComponent* Inventory);
 
+	/**Server only. Called once ExpireTime has passed, with ExpireTime already reset. Consumes the whole stack by default, override to spoil into another item or end a timed effect*/
+	UFUNCTION(BlueprintNativeEvent)
+	void Expire(UFNRInventoryComponent* Inventory);
+
 	UFUNCTION(BlueprintCallable, Category = "Item")
 	void SetQuantity(const int32 NewQuantity);
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+	void SetInstanceState(const FItemInstanceState& NewInstanceState);
+
+	/**Server only. 0 stops the stack from expiring*/
+	UFUNCTION(BlueprintCallable, Category = "Item|Expiry")
+	void SetExpireTime(const double NewExpireTime);
 	
 /*	
  * Helpers
@@ -126,9 +189,21 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Item")
 	FORCEINLINE int GetQuantity() const { return Quantity; }
 
+	/**Quantity including the owning client's pending predictions. Equal to GetQuantity() on the server*/
+	UFUNCTION(BlueprintCallable, Category = "Item")
+	FORCEINLINE int32 GetPredictedQuantity() const { return Quantity + PredictedQuantityDelta; }
+
 	UFUNCTION(BlueprintCallable, Category = "Item")
 	FORCEINLINE bool IsStackFull() const { return Quantity >= MaxStackSize; }
 
+	/**Unique items take one slot per unit and never merge into existing stacks*/
+	UFUNCTION(BlueprintPure, Category = "Item")
+	FORCEINLINE bool IsUnique() const { return !bStackable || MaxStackSize <= 1; }
+
+	/**Seconds until the stack expires, negative if it never does. Uses the server clock on clients too*/
+	UFUNCTION(BlueprintPure, Category = "Item|Expiry")
+	float GetRemainingLifetime() const;
+
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Item")
 	FORCEINLINE UFNRInventoryComponent* GetOwningInventory() { return OwningInventory; }
 };
@@ -0,0 +1,101 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "UObject/ObjectKey.h"
+#include "Utils/RbsTypes.h"
+#include "FNRCraftingComponent.generated.h"
+
+class UFNRCraftingRecipe;
+class UFNRInventoryComponent;
+class UFNRInventoryItem;
+class UFNRRecipeBook;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnCraftableRecipesChanged);
+
+/**Crafts recipes from a UFNRRecipeBook against the owner's UFNRInventoryComponent and tracks which recipes are craftable as the inventory changes*/
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class REUBSINVENTORYSYSTEM_API UFNRCraftingComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFNRCraftingComponent();
+
+////////////////////////////////////////////// Variables ///////////////////////////////////////////////////////////////
+	
+/*
+ * info
+ */
+
+protected:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting")
+	TObjectPtr<UFNRRecipeBook> RecipeBook;
+
+	UPROPERTY()
+	TObjectPtr<UFNRInventoryComponent> Inventory;
+
+/*
+ * Behaviour
+ */
+
+	/**Fired when at least one recipe became craftable or stopped being craftable*/
+	UPROPERTY(BlueprintAssignable, Category = "Crafting")
+	FOnCraftableRecipesChanged OnCraftableRecipesChanged;
+
+/*
+ * Feasibility
+ */
+
+private:
+	//Total quantity per item class, as last seen by this component
+	TMap<TObjectKey<UClass>, int32> ItemCounts;
+
+	//One bit per entry in RecipeBook->Recipes
+	TBitArray<> CraftableRecipes;
+
+	FDelegateHandle ItemChangedHandle;
+
+////////////////////////////////////////////// Functions ///////////////////////////////////////////////////////////////	
+
+/*
+ * Behaviour
+ */
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	/**Consume the ingredients and add the result, or do nothing if either step can't fully succeed. Clients ask the server and return false*/
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+	bool Craft(UFNRCraftingRecipe* Recipe);
+
+	UFUNCTION(Server, Reliable)
+	void ServerCraft(UFNRCraftingRecipe* Recipe);
+
+private:
+	void OnItemChanged(UFNRInventoryItem* Item);
+
+	//Re-evaluate the recipes using ItemClass, returns true if any of them flipped
+	bool RefreshRecipesUsing(const UClass* ItemClass);
+
+	void RebuildFeasibility();
+	bool HasIngredients(const int32 RecipeIndex) const;
+	bool HasRoomForResult(const UFNRCraftingRecipe* Recipe, TConstArrayView<FCraftingIngredient> Requirements) const;
+
+/*
+ * Helpers
+ */
+
+public:
+	/**O(1), reads the tracked feasibility instead of scanning the inventory*/
+	UFUNCTION(BlueprintPure, Category = "Crafting")
+	bool IsRecipeCraftable(const UFNRCraftingRecipe* Recipe) const;
+
+	/**Fill OutRecipes with every currently craftable recipe, reusing its allocation*/
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+	void GetCraftableRecipes(UPARAM(ref) TArray<UFNRCraftingRecipe*>& OutRecipes) const;
+};
@@ -0,0 +1,30 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Utils/RbsTypes.h"
+#include "FNRCraftingRecipe.generated.h"
+
+class UFNRInventoryItem;
+
+UCLASS(BlueprintType)
+class REUBSINVENTORYSYSTEM_API UFNRCraftingRecipe : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Recipe")
+	FText DisplayName;
+
+	//Matched on the exact item class, same as UFNRInventoryComponent::GetItemCount
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Recipe")
+	TArray<FCraftingIngredient> Ingredients;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Recipe")
+	TSubclassOf<UFNRInventoryItem> ResultClass;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Recipe", meta = (ClampMin = 1))
+	int32 ResultQuantity = 1;
+};
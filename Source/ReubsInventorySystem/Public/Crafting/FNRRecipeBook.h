@@ -0,0 +1,44 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "UObject/ObjectKey.h"
+#include "Utils/RbsTypes.h"
+#include "FNRRecipeBook.generated.h"
+
+class UFNRCraftingRecipe;
+
+/**A set of recipes crafted together, e.g. everything a workbench can make. Owns the ingredient -> recipe index shared by every crafter using it*/
+UCLASS(BlueprintType)
+class REUBSINVENTORYSYSTEM_API UFNRRecipeBook : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Recipe Book")
+	TArray<TObjectPtr<UFNRCraftingRecipe>> Recipes;
+
+	/**Indices into Recipes of every recipe that needs ItemClass*/
+	TConstArrayView<int32> GetRecipesUsing(const UClass* ItemClass) const;
+
+	/**Index of Recipe in Recipes, INDEX_NONE if it isn't part of this book*/
+	int32 GetRecipeIndex(const UFNRCraftingRecipe* Recipe) const;
+
+	/**What the recipe at RecipeIndex actually takes: one entry per item class, with the quantities of ingredients listing the same class added up*/
+	TConstArrayView<FCraftingIngredient> GetRequirements(const int32 RecipeIndex) const;
+
+#if WITH_EDITOR	
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	void BuildIndex() const;
+
+	//Built on first use
+	mutable TMap<TObjectKey<UClass>, TArray<int32>> RecipesByIngredient;
+	mutable TMap<TObjectKey<UFNRCraftingRecipe>, int32> RecipeIndices;
+	mutable TArray<TArray<FCraftingIngredient>> RecipeRequirements;
+	mutable bool bIndexBuilt = false;
+};
@@ -0,0 +1,75 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FNRExpirySubsystem.generated.h"
+
+class UFNRInventoryItem;
+
+/**
+ * Expires items whose UFNRInventoryItem::ExpireTime has passed. Every scheduled item lives in one hierarchical timer
+ * wheel, so scheduling is O(1), a tick only looks at the slot that is due, and the expired items are handed to their
+ * inventories in one batch per inventory. Nothing ticks while no item is scheduled.
+ */
+UCLASS(Config = Game)
+class REUBSINVENTORYSYSTEM_API UFNRExpirySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+////////////////////////////////////////////// Variables ///////////////////////////////////////////////////////////////
+	
+/*
+ * info
+ */
+
+protected:
+	/**Seconds per wheel tick. Items expire on the first tick at or after their ExpireTime*/
+	UPROPERTY(Config)
+	float TickInterval = 1.f;
+
+private:
+	//64 slots per level, 4 levels cover 64^4 ticks (about 194 days at one second a tick). Later expiries are parked in the last level and placed again as it turns
+	static constexpr int32 SlotBits = 6;
+	static constexpr int32 SlotsPerLevel = 1 << SlotBits;
+	static constexpr int32 NumLevels = 4;
+	static constexpr uint64 MaxTickDelta = (uint64(1) << (SlotBits * NumLevels)) - 1;
+
+	struct FExpiryEntry
+	{
+		TWeakObjectPtr<UFNRInventoryItem> Item;
+
+		//Item->ExpireTime when it was scheduled. Entries are never removed early, a mismatch means the expiry moved and this entry is stale
+		double ExpireTime = 0.0;
+		uint64 ExpireTick = 0;
+	};
+
+	TArray<FExpiryEntry> Wheel[NumLevels][SlotsPerLevel];
+
+	//Next tick to process, tick N runs once the world time reaches N * TickInterval
+	uint64 CurrentTick = 0;
+
+	//Entries in the wheel, stale ones included
+	int32 NumScheduled = 0;
+
+////////////////////////////////////////////// Functions ///////////////////////////////////////////////////////////////	
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return NumScheduled > 0; }
+	virtual TStatId GetStatId() const override;
+
+	/**Expire Item at its current ExpireTime. Scheduling again after changing ExpireTime is enough, the old entry is ignored*/
+	void ScheduleExpiry(UFNRInventoryItem* Item);
+
+private:
+	void Insert(FExpiryEntry&& Entry);
+
+	//Processes CurrentTick and moves the wheel forward, appending the entries that came due to OutExpired
+	void AdvanceTick(TArray<FExpiryEntry>& OutExpired);
+
+	void DispatchExpired(TConstArrayView<FExpiryEntry> Expired) const;
+
+	uint64 GetTickAt(const double Time, const bool bRoundUp) const;
+};
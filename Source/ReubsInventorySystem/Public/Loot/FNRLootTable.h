@@ -0,0 +1,54 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Utils/RbsTypes.h"
+#include "FNRLootTable.generated.h"
+
+class UFNRInventoryComponent;
+class UFNRInventoryItem;
+
+/**Weighted item drops for containers and loadouts. Each roll picks one entry in constant time through an alias table built on first use*/
+UCLASS(BlueprintType)
+class REUBSINVENTORYSYSTEM_API UFNRLootTable : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Loot Table")
+	TArray<FLootTableEntry> Entries;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Loot Table", meta = (ClampMin = 0))
+	int32 MinRolls = 1;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Loot Table", meta = (ClampMin = 0))
+	int32 MaxRolls = 1;
+
+	/**Server only. Roll the table and add the result to Inventory in one batch, as many full stacks as its free slots and weight allow. Pass the same stream to every container filled at once, seeded for reproducible loot*/
+	UFUNCTION(BlueprintCallable, Category = "Loot Table")
+	void FillInventory(UFNRInventoryComponent* Inventory, UPARAM(ref) FRandomStream& Stream) const;
+
+	/**Roll the table and append the result to OutStacks, rolls of the same item merged into as few stacks as possible, at most MaxStacks stacks and MaxWeight weight*/
+	void GenerateStacks(FRandomStream& Stream, const int32 MaxStacks, const float MaxWeight, TArray<FItemStackRecord>& OutStacks) const;
+
+#if WITH_EDITOR	
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	int32 SampleEntry(FRandomStream& Stream) const;
+	void BuildAliasTable() const;
+
+	//Built on first use. Slot i holds entry SlotEntries[i] with probability SlotProbabilities[i] and entry SlotAliases[i] otherwise
+	mutable TArray<float> SlotProbabilities;
+	mutable TArray<int32> SlotEntries;
+	mutable TArray<int32> SlotAliases;
+
+	//Index into ItemClasses of every entry, so entries sharing a class end up in the same stacks
+	mutable TArray<int32> EntryClassIndices;
+	mutable TArray<TSubclassOf<UFNRInventoryItem>> ItemClasses;
+
+	mutable bool bAliasTableBuilt = false;
+};
@@ -0,0 +1,99 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "FNRStashComponent.generated.h"
+
+class AController;
+class UFNRInventoryComponent;
+class UFNRInventoryItem;
+
+/**
+ * Turns the owner's UFNRInventoryComponent into a persistent container. Its contents stay serialized in
+ * UFNRStashSubsystem until someone opens it, and are written back to disk in batches after they change.
+ */
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class REUBSINVENTORYSYSTEM_API UFNRStashComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFNRStashComponent();
+
+////////////////////////////////////////////// Variables ///////////////////////////////////////////////////////////////
+	
+/*
+ * info
+ */
+
+protected:
+	/**Key in the stash store, e.g. a clan id for a clan stash. Only one container may use a given id at a time*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Stash")
+	FName StashId;
+
+	UPROPERTY()
+	TObjectPtr<UFNRInventoryComponent> Inventory;
+
+private:
+	//Opens without a controller, e.g. server scripts. Only these need a matching CloseStash to keep the count right
+	int32 ServerOpenCount = 0;
+
+	//Controllers that opened the stash and haven't closed it yet. Controllers that went away without closing are pruned on read
+	mutable TArray<TWeakObjectPtr<AController>> Users;
+	bool bMaterialized = false;
+
+	//Set while the subsystem loads or unloads our contents, so those changes don't count as edits
+	bool bApplyingStoredContents = false;
+
+	FDelegateHandle ItemChangedHandle;
+	FDelegateHandle PreAddItemsHandle;
+
+////////////////////////////////////////////// Functions ///////////////////////////////////////////////////////////////	
+
+/*
+ * Behaviour
+ */
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	/**Server only. Makes sure the contents are loaded into the inventory and keeps them loaded until CloseStash. Adding items to a closed stash loads it too*/
+	UFUNCTION(BlueprintCallable, Category = "Stash")
+	void OpenStash(AController* User = nullptr);
+
+	/**Server only. The contents may be unloaded again once nobody has the stash open*/
+	UFUNCTION(BlueprintCallable, Category = "Stash")
+	void CloseStash(AController* User = nullptr);
+
+	//Called by UFNRStashSubsystem
+	void LoadContents(const TArray<uint8>& Data);
+	void SaveContents(TArray<uint8>& OutData) const;
+	void UnloadContents(TArray<uint8>& OutData);
+
+private:
+	void OnItemChanged(UFNRInventoryItem* Item);
+	void OnPreAddItems();
+	void PruneUsers() const;
+
+/*
+ * Helpers
+ */
+
+public:
+	UFUNCTION(BlueprintPure, Category = "Stash")
+	FORCEINLINE FName GetStashId() const { return StashId; }
+
+	UFUNCTION(BlueprintPure, Category = "Stash")
+	bool IsOpen() const;
+
+	/**True if User opened the stash and hasn't closed it, which is what lets its client transfer items in and out*/
+	UFUNCTION(BlueprintPure, Category = "Stash")
+	bool IsOpenedBy(const AController* User) const;
+
+	UFUNCTION(BlueprintPure, Category = "Stash")
+	FORCEINLINE bool IsMaterialized() const { return bMaterialized; }
+};
@@ -0,0 +1,80 @@
+﻿// Copyright Vinipi Studios 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FNRStashSubsystem.generated.h"
+
+class UFNRStashComponent;
+
+/**
+ * Keeps the contents of every UFNRStashComponent in compact serialized form, materializes them into live items on
+ * demand with a cap on how many are live at once, and writes changed stashes back to Saved/Stashes in batches.
+ */
+UCLASS(Config = Game)
+class REUBSINVENTORYSYSTEM_API UFNRStashSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+////////////////////////////////////////////// Variables ///////////////////////////////////////////////////////////////
+	
+/*
+ * info
+ */
+
+protected:
+	/**Closed stashes beyond this count are serialized and their items destroyed, least recently opened first*/
+	UPROPERTY(Config)
+	int32 MaxMaterializedStashes = 32;
+
+	UPROPERTY(Config)
+	float FlushInterval = 10.f;
+
+	/**Most dirty stashes written per flush, the rest wait for the next one*/
+	UPROPERTY(Config)
+	int32 MaxStashesPerFlush = 16;
+
+private:
+	struct FStashEntry
+	{
+		//Serialized contents, only up to date while the stash isn't materialized
+		TArray<uint8> Data;
+		TWeakObjectPtr<UFNRStashComponent> Component;
+		bool bLoaded = false;
+		bool bDirty = false;
+	};
+
+	TMap<FName, FStashEntry> Stashes;
+
+	//Materialized stash ids, least recently opened first
+	TArray<FName> MaterializedStashes;
+
+	FTimerHandle FlushTimerHandle;
+
+	//Disk writes of the previous flush, a new flush waits for it so writes to the same file stay in order
+	TFuture<void> PendingWrite;
+
+////////////////////////////////////////////// Functions ///////////////////////////////////////////////////////////////	
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	void RegisterStash(UFNRStashComponent* Stash);
+	void UnregisterStash(UFNRStashComponent* Stash);
+	void MaterializeStash(UFNRStashComponent* Stash);
+	void MarkStashDirty(const UFNRStashComponent* Stash);
+
+	/**Write every dirty stash now instead of waiting for the next batch*/
+	UFUNCTION(BlueprintCallable, Category = "Stash")
+	void FlushAll();
+
+private:
+	FStashEntry& FindOrLoadEntry(const FName StashId);
+	void EnforceMaterializedCap();
+	void FlushDirty(const int32 MaxStashes);
+
+	static FString GetStashPath(const FName StashId);
+};
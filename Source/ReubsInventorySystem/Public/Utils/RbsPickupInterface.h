@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Interface.h"
+#include "Utils/RbsTypes.h"
 #include "RbsPickupInterface.generated.h"
 
 // This class does not need to be modified.
@@ -22,6 +23,10 @@ public:
 	UFUNCTION(BlueprintNativeEvent)
 	void SetPickupQuantity(const int32 NewQuantity);
 
+	/**Everything about the dropped units, sent right after SetPickupQuantity. Keep it and hand it back to UFNRInventoryComponent::TryAddStack on pickup so instance state and expiry survive the drop*/
+	UFUNCTION(BlueprintNativeEvent)
+	void SetPickupStack(const FItemStackRecord& Stack);
+
 	UFUNCTION(BlueprintNativeEvent)
 	void OnDropItem();
 };
@@ -15,6 +15,140 @@ enum class EItemAddResult : uint8
 	IAR_AllItemsAdded UMETA(DisplayName = "All items added")
 };
 
+UENUM(BlueprintType)
+enum class EInventorySortMode : uint8
+{
+	ISM_None UMETA(DisplayName = "None"),
+	ISM_Category UMETA(DisplayName = "Category"),
+	ISM_Weight UMETA(DisplayName = "Weight"),
+	ISM_Name UMETA(DisplayName = "Name"),
+	ISM_Value UMETA(DisplayName = "Value")
+};
+
+/**Per-instance data carried by unique (non-stackable) items. Stackable items keep the defaults since units in a stack are interchangeable*/
+USTRUCT(BlueprintType)
+struct FItemInstanceState
+{
+	GENERATED_BODY()
+
+	//Normalized, 1 is brand new
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Instance State", meta = (ClampMin = 0.0, ClampMax = 1.0))
+	float Durability = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Instance State")
+	TArray<TSubclassOf<UFNRInventoryItem>> Attachments;
+};
+
+/**A stat change an item applies while equipped. Equipped modifiers are summed per stat, then applied as (Base + Additive) * Multiplier*/
+USTRUCT(BlueprintType)
+struct FItemStatModifier
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stat Modifier")
+	FName Stat;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stat Modifier")
+	float Additive = 0.f;
+
+	//Multipliers of every equipped item are multiplied together
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stat Modifier")
+	float Multiplier = 1.f;
+};
+
+USTRUCT(BlueprintType)
+struct FEquippedItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Equipped Item")
+	FName Slot;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Equipped Item")
+	TObjectPtr<UFNRInventoryItem> Item = nullptr;
+};
+
+/**What non-owners see of an equipment slot: enough to show the gear, without the item object or its stats*/
+USTRUCT(BlueprintType)
+struct FEquippedItemSummary
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Equipped Item")
+	FName Slot;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Equipped Item")
+	TSubclassOf<UFNRInventoryItem> ItemClass;
+};
+
+/**Everything needed to recreate a stack without keeping its UObject around*/
+USTRUCT(BlueprintType)
+struct FItemStackRecord
+{
+	GENERATED_BODY()
+
+	//Kept when the stack is imported again, 0 to get a fresh id
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stack Record")
+	int64 ItemId = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stack Record")
+	TSubclassOf<UFNRInventoryItem> ItemClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stack Record", meta = (ClampMin = 1))
+	int32 Quantity = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stack Record")
+	FItemInstanceState InstanceState;
+
+	//Wall clock time the stack expires at, so it keeps counting down while only the record exists. Left unset to use the item's Lifetime
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item Stack Record")
+	FDateTime ExpiresAtUtc;
+};
+
+USTRUCT(BlueprintType)
+struct FCraftingIngredient
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting Ingredient")
+	TSubclassOf<UFNRInventoryItem> ItemClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting Ingredient", meta = (ClampMin = 1))
+	int32 Quantity = 1;
+};
+
+USTRUCT(BlueprintType)
+struct FLootTableEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Loot Table Entry")
+	TSubclassOf<UFNRInventoryItem> ItemClass;
+
+	//Relative to the other entries of the table, 0 disables the entry
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Loot Table Entry", meta = (ClampMin = 0.0))
+	float Weight = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Loot Table Entry", meta = (ClampMin = 1))
+	int32 MinQuantity = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Loot Table Entry", meta = (ClampMin = 1))
+	int32 MaxQuantity = 1;
+};
+
+UENUM(BlueprintType)
+enum class EInventoryAuditAction : uint8
+{
+	IAA_Add UMETA(DisplayName = "Add"),
+	IAA_Consume UMETA(DisplayName = "Consume"),
+	IAA_Drop UMETA(DisplayName = "Drop"),
+	IAA_Remove UMETA(DisplayName = "Remove"),
+	IAA_Import UMETA(DisplayName = "Import"),
+	IAA_Clear UMETA(DisplayName = "Clear"),
+	IAA_Transfer UMETA(DisplayName = "Transfer"),
+	IAA_Rejected UMETA(DisplayName = "Rejected")
+};
+
 USTRUCT(BlueprintType)
 struct FItemAddResult
 {
@@ -71,4 +205,16 @@ struct FItemAddResult
 
 		return AddAllResult;
 	}
+};
+
+/**A consumption the owning client applied locally before the server confirmed it*/
+struct FItemPrediction
+{
+	//Key sent to the server along with the RPC, acknowledged through UFNRInventoryComponent::LastAckedPredictionKey
+	int32 PredictionKey = 0;
+
+	TWeakObjectPtr<UFNRInventoryItem> Item;
+
+	//How many units of Item the client assumed were removed
+	int32 Quantity = 0;
 };
\ No newline at end of file